@@ -16,29 +16,6 @@
 #include <QTextEdit>
 #include <QUrl>
 
-auto isPlainText(const QString &str) -> bool {
-    if (str.isEmpty()) {
-        return true;
-    }
-    auto textCharCount = 0;
-    auto totalCharCount = 0;
-    for (const auto &ch : str) {
-        totalCharCount++;
-        if (ch == '\0') {
-            return false;
-        }
-        if (ch.isLetterOrNumber() || ch.isPunct() || ch.isSpace() || ch.isSymbol() || ch.isMark()) {
-            textCharCount++;
-        } else if (ch.category() == QChar::Other_Control && ch.unicode() < 32) {
-            if (ch == '\n' || ch == '\r' || ch == '\t') {
-                textCharCount++;
-            }
-        }
-    }
-    auto textRatio = static_cast<double>(textCharCount) / totalCharCount;
-    return textRatio > 0.90;
-}
-
 const QMap<int, QString> &defaultFgColorMap() {
     static const QMap<int, QString> fg = {
         {30, "#000000"}, {31, "#ff0000"}, {32, "#00ff00"}, {33, "#ffff00"},
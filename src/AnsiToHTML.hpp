@@ -13,9 +13,6 @@
 class QTextEdit;
 class QString;
 
-/// Returns true, if a string is binary, or plain text
-auto isPlainText(const QString &str) -> bool;
-
 /// Helper function, appends plain text to to a QTextEdit
 auto appendAscii(QTextEdit *edit, const QString &plainText) -> void;
 
@@ -0,0 +1,517 @@
+/**
+ * \file DirectoryWalker.cpp
+ * \brief Recursive directory traversal which honors .gitignore files
+ * \author Diego Iastrubni diegoiast@gmail.com
+ */
+
+// SPDX-License-Identifier: MIT
+
+#include <algorithm>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+#include <QDir>
+#include <QDirIterator>
+#include <QFile>
+#include <QFileInfo>
+#include <QStringList>
+
+#include "DirectoryWalker.hpp"
+
+#if defined(Q_OS_UNIX)
+#include <dirent.h>
+#include <sys/stat.h>
+#endif
+
+// Returns the index of the ']' closing a class which starts at `start`, or -1
+static auto findClassEnd(QStringView pattern, qsizetype start) -> qsizetype {
+    auto i = start + 1;
+    if (i < pattern.size() && (pattern[i] == '!' || pattern[i] == '^')) {
+        i++;
+    }
+    if (i < pattern.size() && pattern[i] == ']') {
+        i++;
+    }
+    while (i < pattern.size() && pattern[i] != ']') {
+        i++;
+    }
+    return i < pattern.size() ? i : -1;
+}
+
+static auto classMatches(QStringView body, QChar c) -> bool {
+    auto negated = !body.isEmpty() && (body[0] == '!' || body[0] == '^');
+    if (negated) {
+        body = body.sliced(1);
+    }
+    auto found = false;
+    for (auto i = qsizetype(0); i < body.size() && !found; i++) {
+        if (i + 2 < body.size() && body[i + 1] == '-') {
+            found = c >= body[i] && c <= body[i + 2];
+            i += 2;
+        } else {
+            found = c == body[i];
+        }
+    }
+    return found != negated;
+}
+
+auto DirectoryWalker::globMatch(QStringView pattern, QStringView text) -> bool {
+    auto p = qsizetype(0);
+    auto t = qsizetype(0);
+    while (p < pattern.size()) {
+        auto c = pattern[p];
+        if (c == '*') {
+            if (p + 1 < pattern.size() && pattern[p + 1] == '*') {
+                auto rest = p + 2;
+                if (rest < pattern.size() && pattern[rest] == '/') {
+                    // "**/" - zero or more directories
+                    auto tail = pattern.sliced(rest + 1);
+                    if (globMatch(tail, text.sliced(t))) {
+                        return true;
+                    }
+                    for (auto i = t; i < text.size(); i++) {
+                        if (text[i] == '/' && globMatch(tail, text.sliced(i + 1))) {
+                            return true;
+                        }
+                    }
+                    return false;
+                }
+                for (auto i = t; i <= text.size(); i++) {
+                    if (globMatch(pattern.sliced(rest), text.sliced(i))) {
+                        return true;
+                    }
+                }
+                return false;
+            }
+            // A single star does not cross directories
+            for (auto i = t; i <= text.size(); i++) {
+                if (globMatch(pattern.sliced(p + 1), text.sliced(i))) {
+                    return true;
+                }
+                if (i < text.size() && text[i] == '/') {
+                    break;
+                }
+            }
+            return false;
+        }
+        if (c == '?') {
+            if (t >= text.size() || text[t] == '/') {
+                return false;
+            }
+            p++;
+            t++;
+            continue;
+        }
+        if (c == '[') {
+            auto end = findClassEnd(pattern, p);
+            if (end > 0) {
+                if (t >= text.size() || text[t] == '/' ||
+                    !classMatches(pattern.sliced(p + 1, end - p - 1), text[t])) {
+                    return false;
+                }
+                p = end + 1;
+                t++;
+                continue;
+            }
+        }
+        if (c == '\\' && p + 1 < pattern.size()) {
+            p++;
+            c = pattern[p];
+        }
+        if (t >= text.size() || text[t] != c) {
+            return false;
+        }
+        p++;
+        t++;
+    }
+    return t == text.size();
+}
+
+DirectoryWalker::DirectoryWalker(const QString &rootDir)
+    : rootDir(QDir::cleanPath(QDir::fromNativeSeparators(rootDir))) {}
+
+auto DirectoryWalker::setTopDir(const QString &dir) -> void {
+    topDir = dir.isEmpty() ? QString() : QDir::cleanPath(QDir::fromNativeSeparators(dir));
+}
+
+auto DirectoryWalker::setExcludedPaths(const QStringList &relativePaths) -> void {
+    excludedPaths = QSet<QString>(relativePaths.cbegin(), relativePaths.cend());
+}
+
+auto DirectoryWalker::walk(const FileCallback &onFile) -> bool {
+    auto ignores = IgnoreChain();
+    if (useIgnoreFiles && !loadParentIgnoreFiles(ignores)) {
+        // The root itself is ignored
+        return true;
+    }
+    return walkDirectory({}, ignores, onFile);
+}
+
+auto DirectoryWalker::walkParallel(const FilesCallback &onFiles, unsigned int threadCount)
+    -> bool {
+    auto onListing = [&onFiles](DirectoryListing &&listing) {
+        if (listing.files.isEmpty()) {
+            return true;
+        }
+        for (auto &file : listing.files) {
+            file.prepend(listing.relativeDir);
+        }
+        return onFiles(std::move(listing.files));
+    };
+    return walkDirectories(onListing, {}, threadCount);
+}
+
+auto DirectoryWalker::walkDirectories(const ListingCallback &onListing,
+                                      const KnownDirectoryCallback &isKnown,
+                                      unsigned int threadCount, const QString &startDir)
+    -> bool {
+    auto rootIgnores = IgnoreChain();
+    if (useIgnoreFiles && !loadParentIgnoreFiles(rootIgnores)) {
+        return true;
+    }
+    // The ignore files of the root, and of the directories between it and the start
+    if (!startDir.isEmpty()) {
+        loadDirectoryIgnoreFiles({}, rootIgnores);
+        auto end = startDir.indexOf('/');
+        while (end >= 0 && end + 1 < startDir.size()) {
+            loadDirectoryIgnoreFiles(startDir.left(end + 1), rootIgnores);
+            end = startDir.indexOf('/', end + 1);
+        }
+    }
+    if (threadCount == 0) {
+        threadCount = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    struct DirectoryTask {
+        QString relativeDir;
+        IgnoreChain ignores;
+    };
+
+    auto mutex = std::mutex();
+    auto wakeUp = std::condition_variable();
+    auto pending = std::vector<DirectoryTask>{{startDir, rootIgnores}};
+    auto busy = size_t(0);
+    auto stopped = false;
+    auto outputMutex = std::mutex();
+
+    // Directories are taken from the back (depth first), which keeps the pending list small.
+    // The walk is done when nothing is pending, and no thread can add more.
+    auto work = [&]() {
+        auto lock = std::unique_lock(mutex);
+        while (true) {
+            wakeUp.wait(lock, [&]() { return stopped || !pending.empty() || busy == 0; });
+            if (stopped || pending.empty()) {
+                return;
+            }
+            auto task = std::move(pending.back());
+            pending.pop_back();
+            busy++;
+            lock.unlock();
+
+            auto listing = DirectoryListing{task.relativeDir, {}, {}};
+            auto keepGoing = true;
+            loadDirectoryIgnoreFiles(task.relativeDir, task.ignores);
+            if (!isKnown || !isKnown(task.relativeDir, listing.subDirectories)) {
+                readDirectory(task.relativeDir, task.ignores, listing.files,
+                              listing.subDirectories);
+                auto outputLock = std::unique_lock(outputMutex);
+                keepGoing = onListing(DirectoryListing(listing));
+            }
+
+            lock.lock();
+            busy--;
+            stopped = stopped || !keepGoing;
+            for (auto const &dir : std::as_const(listing.subDirectories)) {
+                pending.push_back({task.relativeDir + dir + '/', task.ignores});
+            }
+            if (stopped || !listing.subDirectories.isEmpty() || busy == 0) {
+                wakeUp.notify_all();
+            }
+        }
+    };
+
+    auto threads = std::vector<std::thread>();
+    for (auto i = 1u; i < threadCount; i++) {
+        threads.emplace_back(work);
+    }
+    work();
+    for (auto &thread : threads) {
+        thread.join();
+    }
+    return !stopped;
+}
+
+auto DirectoryWalker::isWalked(const QString &relativeFileName) const -> bool {
+    auto const parts = relativeFileName.split('/');
+    auto path = QString();
+    for (auto const &part : parts) {
+        path += path.isEmpty() ? part : '/' + part;
+        if (part.isEmpty() || part.startsWith('.') || excludedPaths.contains(path)) {
+            return false;
+        }
+    }
+    if (!useIgnoreFiles) {
+        return true;
+    }
+
+    // The same rules the walk would have loaded on its way down to the file
+    auto ignores = IgnoreChain();
+    if (!loadParentIgnoreFiles(ignores)) {
+        return false;
+    }
+    auto relativeDir = QString();
+    for (auto i = 0; i + 1 < parts.size(); i++) {
+        loadDirectoryIgnoreFiles(relativeDir, ignores);
+        relativeDir += parts[i];
+        if (isIgnored(ignores, relativeDir, true)) {
+            return false;
+        }
+        relativeDir += '/';
+    }
+    loadDirectoryIgnoreFiles(relativeDir, ignores);
+    return !isIgnored(ignores, relativeFileName, false);
+}
+
+// Loads the ignore files of the directories above the root, from the top down.
+// Returns false if they ignore the root, or one of the directories leading to it.
+auto DirectoryWalker::loadParentIgnoreFiles(IgnoreChain &ignores) const -> bool {
+    auto chain = QStringList{rootDir};
+    auto top = QString();
+    for (auto dir = rootDir;;) {
+        if ((!topDir.isEmpty() && dir == topDir) || QFileInfo::exists(dir + "/.git")) {
+            top = dir;
+            break;
+        }
+        auto parent = QFileInfo(dir).path();
+        if (parent == dir || (!topDir.isEmpty() && !parent.startsWith(topDir))) {
+            break;
+        }
+        chain.prepend(parent);
+        dir = parent;
+    }
+    if (top.isEmpty()) {
+        return true;
+    }
+
+    auto prefixFor = [this](const QString &dir) {
+        return dir == rootDir ? QString() : rootDir.mid(dir.size() + 1) + '/';
+    };
+    loadIgnoreFile(top + "/.git/info/exclude", {}, ignores, prefixFor(top));
+    for (auto i = 0; i + 1 < chain.size(); i++) {
+        auto const &dir = chain[i];
+        if (i > 0 && isParentIgnored(ignores, dir)) {
+            return false;
+        }
+        loadIgnoreFile(dir + "/.gitignore", {}, ignores, prefixFor(dir));
+        loadIgnoreFile(dir + "/.ignore", {}, ignores, prefixFor(dir));
+    }
+    return !isParentIgnored(ignores, rootDir);
+}
+
+auto DirectoryWalker::walkDirectory(const QString &relativeDir, const IgnoreChain &ignores,
+                                    const FileCallback &onFile) const -> bool {
+    // Files are reported first, and sub directories are visited once this directory
+    // is closed, so the number of open directories stays small.
+    auto localIgnores = ignores;
+    auto files = QStringList();
+    auto subDirectories = QStringList();
+    loadDirectoryIgnoreFiles(relativeDir, localIgnores);
+    readDirectory(relativeDir, localIgnores, files, subDirectories);
+    auto const dirPath = rootDir + '/' + relativeDir;
+    for (auto const &file : std::as_const(files)) {
+        if (!onFile(dirPath + file, relativeDir + file)) {
+            return false;
+        }
+    }
+    for (auto const &dir : std::as_const(subDirectories)) {
+        if (!walkDirectory(relativeDir + dir + '/', localIgnores, onFile)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+#if defined(Q_OS_UNIX)
+// Resolves the type of an entry the listing did not tell, or of a symbolic link target.
+// Links to directories are reported as links, so they are never followed.
+static auto entryType(const QByteArray &dirPath, const char *name, unsigned char type)
+    -> unsigned char {
+    auto const fullName = dirPath + '/' + name;
+    struct stat st;
+    if (type == DT_UNKNOWN) {
+        if (::lstat(fullName.constData(), &st) != 0) {
+            return DT_UNKNOWN;
+        }
+        if (!S_ISLNK(st.st_mode)) {
+            return S_ISDIR(st.st_mode) ? DT_DIR : S_ISREG(st.st_mode) ? DT_REG : DT_UNKNOWN;
+        }
+    }
+    if (::stat(fullName.constData(), &st) != 0) {
+        return DT_UNKNOWN;
+    }
+    return S_ISREG(st.st_mode) ? DT_REG : DT_LNK;
+}
+#endif
+
+auto DirectoryWalker::loadDirectoryIgnoreFiles(const QString &relativeDir,
+                                               IgnoreChain &ignores) const -> void {
+    if (useIgnoreFiles) {
+        auto const dirPath = rootDir + '/' + relativeDir;
+        loadIgnoreFile(dirPath + ".gitignore", relativeDir, ignores);
+        loadIgnoreFile(dirPath + ".ignore", relativeDir, ignores);
+    }
+}
+
+// Fills the names of the files and sub directories which are not ignored
+auto DirectoryWalker::readDirectory(const QString &relativeDir, const IgnoreChain &ignores,
+                                    QStringList &files, QStringList &directories) const
+    -> void {
+    auto const dirPath = relativeDir.isEmpty() ? rootDir : rootDir + '/' + relativeDir;
+    auto addEntry = [&](const QString &name, bool isDir) {
+        if (!excludedPaths.isEmpty() && excludedPaths.contains(relativeDir + name)) {
+            return;
+        }
+        if (ignores && isIgnored(ignores, relativeDir + name, isDir)) {
+            return;
+        }
+        if (isDir) {
+            directories.append(name);
+        } else {
+            files.append(name);
+        }
+    };
+
+#if defined(Q_OS_UNIX)
+    auto const encodedPath = QFile::encodeName(dirPath);
+    auto dir = ::opendir(encodedPath.constData());
+    if (!dir) {
+        return;
+    }
+    while (auto entry = ::readdir(dir)) {
+        // Hidden entries, and the "." and ".." entries
+        if (entry->d_name[0] == '.') {
+            continue;
+        }
+        auto type = entry->d_type;
+        if (type == DT_UNKNOWN || type == DT_LNK) {
+            type = entryType(encodedPath, entry->d_name, type);
+        }
+        if (type == DT_DIR || type == DT_REG) {
+            addEntry(QFile::decodeName(entry->d_name), type == DT_DIR);
+        }
+    }
+    ::closedir(dir);
+#else
+    QDirIterator it(dirPath, QDir::Dirs | QDir::Files | QDir::NoDotAndDotDot);
+    while (it.hasNext()) {
+        auto info = it.nextFileInfo();
+        auto isDir = info.isDir();
+        if (isDir && info.isSymLink()) {
+            continue;
+        }
+        addEntry(info.fileName(), isDir);
+    }
+#endif
+}
+
+// Adds the rules of the file in front of the chain, if it has any
+auto DirectoryWalker::loadIgnoreFile(const QString &fileName, const QString &relativeDir,
+                                     IgnoreChain &ignores, const QString &prefix) -> void {
+    auto file = QFile(fileName);
+    if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) {
+        return;
+    }
+
+    auto list = IgnoreList{relativeDir, prefix, {}, ignores};
+    while (!file.atEnd()) {
+        auto line = QString::fromUtf8(file.readLine());
+        while (line.endsWith('\n') || line.endsWith('\r')) {
+            line.chop(1);
+        }
+        while (line.endsWith(' ') && !line.endsWith("\\ ")) {
+            line.chop(1);
+        }
+        if (line.isEmpty() || line.startsWith('#')) {
+            continue;
+        }
+
+        auto rule = IgnoreRule();
+        if (line.startsWith('!')) {
+            rule.negated = true;
+            line.remove(0, 1);
+        } else if (line.startsWith("\\!") || line.startsWith("\\#")) {
+            line.remove(0, 1);
+        }
+        if (line.endsWith('/')) {
+            rule.directoryOnly = true;
+            line.chop(1);
+        }
+        if (line.startsWith('/')) {
+            rule.anchored = true;
+            line.remove(0, 1);
+        } else {
+            rule.anchored = line.contains('/');
+        }
+        if (line.isEmpty()) {
+            continue;
+        }
+        rule.pattern = line;
+        list.rules.push_back(std::move(rule));
+    }
+
+    if (list.rules.empty()) {
+        return;
+    }
+    ignores = std::make_shared<const IgnoreList>(std::move(list));
+}
+
+// Returns 1 if the path is ignored by the list, 0 if it is re-included, -1 if no rule matched
+auto DirectoryWalker::matchRules(const std::vector<IgnoreRule> &rules, QStringView path,
+                                 bool isDir) -> int {
+    auto slash = path.lastIndexOf('/');
+    auto name = slash < 0 ? path : path.sliced(slash + 1);
+    for (auto rule = rules.crbegin(); rule != rules.crend(); ++rule) {
+        if (rule->directoryOnly && !isDir) {
+            continue;
+        }
+        if (globMatch(rule->pattern, rule->anchored ? path : name)) {
+            return rule->negated ? 0 : 1;
+        }
+    }
+    return -1;
+}
+
+auto DirectoryWalker::isIgnored(const IgnoreChain &ignores, const QString &relativePath,
+                                bool isDir) -> bool {
+    for (auto list = ignores.get(); list; list = list->parent.get()) {
+        auto local = QStringView(relativePath).sliced(list->baseDir.size());
+        auto result = 0;
+        if (list->prefix.isEmpty()) {
+            result = matchRules(list->rules, local, isDir);
+        } else {
+            result = matchRules(list->rules, QString(list->prefix + local.toString()), isDir);
+        }
+        if (result >= 0) {
+            return result == 1;
+        }
+    }
+    return false;
+}
+
+// Checks a directory between the top and the root (inclusive) against the lists loaded
+// so far, which all belong to directories above it.
+auto DirectoryWalker::isParentIgnored(const IgnoreChain &ignores, const QString &dir) const
+    -> bool {
+    for (auto list = ignores.get(); list; list = list->parent.get()) {
+        auto listDir = rootDir.left(rootDir.size() - list->prefix.size());
+        if (!dir.startsWith(listDir + '/')) {
+            continue;
+        }
+        auto result = matchRules(list->rules, QStringView(dir).sliced(listDir.size() + 1), true);
+        if (result >= 0) {
+            return result == 1;
+        }
+    }
+    return false;
+}
@@ -0,0 +1,130 @@
+/**
+ * \file DirectoryWalker.hpp
+ * \brief Recursive directory traversal which honors .gitignore files
+ * \author Diego Iastrubni diegoiast@gmail.com
+ */
+
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include <QSet>
+#include <QString>
+#include <QStringList>
+
+/**
+ * Walks a directory tree, reporting files only.
+ *
+ * Hidden entries are skipped. When ignore files are used, `.gitignore` and `.ignore` files
+ * (and `.git/info/exclude` at the root) are read as the walk goes down, with the usual git
+ * rules: deeper files override the upper ones, later lines override earlier ones, `!`
+ * re-includes, a trailing `/` matches only directories, and a `/` anywhere else anchors the
+ * pattern to the directory of the ignore file.
+ *
+ * Ignored directories are pruned before they are opened. Entry types come from the directory
+ * listing itself (readdir() and d_type on POSIX), so files and directories are not stat()ed
+ * one by one, except symbolic links, which are reported when they point to files, and never
+ * followed into directories.
+ *
+ * walkParallel() and walkDirectories() read directories concurrently, on a pool of threads.
+ * The ignore rules of each directory are kept as an immutable chain shared with its sub
+ * directories, so threads need no locking to check them.
+ */
+class DirectoryWalker {
+  public:
+    // Return false to stop the walk
+    using FileCallback =
+        std::function<bool(const QString &fullFileName, const QString &relativeFileName)>;
+    // Called with the files of one directory (as relative paths), never concurrently.
+    // Return false to stop the walk.
+    using FilesCallback = std::function<bool(QStringList &&relativeFileNames)>;
+
+    struct DirectoryListing {
+        // Relative to the root, empty or ending with '/'
+        QString relativeDir;
+        // Names only, without the directory
+        QStringList files;
+        QStringList subDirectories;
+    };
+    // Called for each directory which was read, never concurrently. Return false to stop.
+    using ListingCallback = std::function<bool(DirectoryListing &&listing)>;
+    // Called before a directory is read, concurrently. Return true if the content of the
+    // directory is already known, and fill its sub directories (names only): the directory is
+    // not read, and only the given sub directories are walked.
+    using KnownDirectoryCallback =
+        std::function<bool(const QString &relativeDir, QStringList &subDirectories)>;
+
+    explicit DirectoryWalker(const QString &rootDir);
+
+    auto setUseIgnoreFiles(bool use) -> void { useIgnoreFiles = use; }
+    auto getUseIgnoreFiles() const -> bool { return useIgnoreFiles; }
+    auto getRootDir() const -> const QString & { return rootDir; }
+
+    // Ignore files in the directories above the root are read up to this directory.
+    // By default, up to the top of the git checkout containing the root, if any.
+    auto setTopDir(const QString &dir) -> void;
+    // Paths relative to the root (without a trailing '/') which are skipped with all they
+    // contain, as if they were ignored
+    auto setExcludedPaths(const QStringList &relativePaths) -> void;
+
+    // Returns false if the walk was stopped by the callback
+    auto walk(const FileCallback &onFile) -> bool;
+    // Same, but reads directories on `threadCount` threads (0 means one per core). The
+    // callback is called from these threads, and directories are reported in no given order.
+    auto walkParallel(const FilesCallback &onFiles, unsigned int threadCount = 0) -> bool;
+    // The parallel walk, reported a directory at a time. Directories the caller knows
+    // already can be skipped, for incremental scans. The walk can start at a directory below
+    // the root (relative, ending with '/'), the ignore files above it are honored.
+    auto walkDirectories(const ListingCallback &onListing,
+                         const KnownDirectoryCallback &isKnown = {},
+                         unsigned int threadCount = 0, const QString &startDir = {}) -> bool;
+
+    // Whether a walk would report this file (relative to the root), if it exists: no part
+    // of its path is hidden or ignored
+    auto isWalked(const QString &relativeFileName) const -> bool;
+
+    static auto globMatch(QStringView pattern, QStringView text) -> bool;
+
+  private:
+    struct IgnoreRule {
+        QString pattern;
+        bool negated = false;
+        bool directoryOnly = false;
+        bool anchored = false;
+    };
+
+    struct IgnoreList {
+        // Relative to the root, empty or ending with '/'
+        QString baseDir;
+        // For ignore files above the root: the path of the root relative to them, with a '/'
+        QString prefix;
+        std::vector<IgnoreRule> rules;
+        // The lists of the directories above, the closest first
+        std::shared_ptr<const IgnoreList> parent;
+    };
+    using IgnoreChain = std::shared_ptr<const IgnoreList>;
+
+    auto walkDirectory(const QString &relativeDir, const IgnoreChain &ignores,
+                       const FileCallback &onFile) const -> bool;
+    auto loadDirectoryIgnoreFiles(const QString &relativeDir, IgnoreChain &ignores) const
+        -> void;
+    auto readDirectory(const QString &relativeDir, const IgnoreChain &ignores, QStringList &files,
+                       QStringList &directories) const -> void;
+    auto loadParentIgnoreFiles(IgnoreChain &ignores) const -> bool;
+    static auto loadIgnoreFile(const QString &fileName, const QString &relativeDir,
+                               IgnoreChain &ignores, const QString &prefix = {}) -> void;
+    static auto isIgnored(const IgnoreChain &ignores, const QString &relativePath, bool isDir)
+        -> bool;
+    auto isParentIgnored(const IgnoreChain &ignores, const QString &dir) const -> bool;
+    static auto matchRules(const std::vector<IgnoreRule> &rules, QStringView path, bool isDir)
+        -> int;
+
+    QString rootDir;
+    QString topDir;
+    QSet<QString> excludedPaths;
+    bool useIgnoreFiles = true;
+};
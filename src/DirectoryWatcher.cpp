@@ -0,0 +1,186 @@
+/**
+ * \file DirectoryWatcher.cpp
+ * \brief Watches many directories for added, removed and renamed entries
+ * \author Diego Iastrubni diegoiast@gmail.com
+ */
+
+// SPDX-License-Identifier: MIT
+
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QSocketNotifier>
+#include <QTimer>
+
+#include "DirectoryWatcher.hpp"
+
+#if defined(Q_OS_LINUX)
+#include <cerrno>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+static constexpr auto WatchMask = uint32_t(IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO |
+                                           IN_DELETE_SELF | IN_MOVE_SELF | IN_CLOSE_WRITE |
+                                           IN_ONLYDIR | IN_DONTFOLLOW | IN_EXCL_UNLINK);
+#endif
+
+static auto isIgnoreFile(const QString &name) -> bool {
+    return name == ".gitignore" || name == ".ignore";
+}
+
+DirectoryWatcher::DirectoryWatcher(const QString &rootDir, QObject *parent)
+    : QObject(parent), rootDir(QDir::cleanPath(QDir::fromNativeSeparators(rootDir))) {
+    coalesceTimer = new QTimer(this);
+    coalesceTimer->setSingleShot(true);
+    coalesceTimer->setInterval(CoalesceDelay);
+    connect(coalesceTimer, &QTimer::timeout, this, &DirectoryWatcher::flush);
+
+#if defined(Q_OS_LINUX)
+    fd = ::inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (fd < 0) {
+        qWarning() << "DirectoryWatcher: inotify is not available" << errno;
+        return;
+    }
+    notifier = new QSocketNotifier(fd, QSocketNotifier::Read, this);
+    connect(notifier, &QSocketNotifier::activated, this, &DirectoryWatcher::readEvents);
+#endif
+}
+
+DirectoryWatcher::~DirectoryWatcher() {
+#if defined(Q_OS_LINUX)
+    if (fd >= 0) {
+        // Closing the descriptor drops all the watches
+        delete notifier;
+        ::close(fd);
+    }
+#endif
+}
+
+auto DirectoryWatcher::watch(const QStringList &relativeDirs) -> bool {
+#if defined(Q_OS_LINUX)
+    if (fd < 0) {
+        return false;
+    }
+    for (auto const &dir : relativeDirs) {
+        if (watchedDirs.contains(dir)) {
+            continue;
+        }
+        auto const path = QFile::encodeName(rootDir + '/' + dir);
+        auto wd = ::inotify_add_watch(fd, path.constData(), WatchMask);
+        if (wd < 0) {
+            if (errno == ENOSPC) {
+                qWarning() << "DirectoryWatcher: the inotify watch limit was reached, see"
+                           << "/proc/sys/fs/inotify/max_user_watches";
+                return false;
+            }
+            // Removed meanwhile, or not readable
+            continue;
+        }
+        watches.insert(wd, dir);
+        watchedDirs.insert(dir, wd);
+    }
+    return true;
+#else
+    Q_UNUSED(relativeDirs);
+    return false;
+#endif
+}
+
+auto DirectoryWatcher::markChanged(const QStringList &relativeDirs) -> void {
+    for (auto const &dir : relativeDirs) {
+        changed.insert(dir);
+    }
+    if (!changed.isEmpty() && !coalesceTimer->isActive()) {
+        coalesceTimer->start();
+    }
+}
+
+auto DirectoryWatcher::readEvents() -> void {
+#if defined(Q_OS_LINUX)
+    alignas(struct inotify_event) char buffer[64 * 1024];
+    auto overflow = false;
+    while (true) {
+        auto length = ::read(fd, buffer, sizeof(buffer));
+        if (length <= 0) {
+            break;
+        }
+        for (auto p = buffer; p < buffer + length;) {
+            auto const event = reinterpret_cast<const struct inotify_event *>(p);
+            p += sizeof(struct inotify_event) + event->len;
+            if (event->mask & IN_Q_OVERFLOW) {
+                overflow = true;
+                continue;
+            }
+            auto it = watches.constFind(event->wd);
+            if (it == watches.cend()) {
+                continue;
+            }
+            auto const dir = it.value();
+            if (event->mask & IN_IGNORED) {
+                // The kernel dropped the watch, the directory is gone
+                watches.remove(event->wd);
+                watchedDirs.remove(dir);
+                continue;
+            }
+            if (event->mask & (IN_DELETE_SELF | IN_MOVE_SELF)) {
+                // Whatever is at this path now is not what is watched
+                changed.insert(dir);
+                forgetTree(dir);
+                continue;
+            }
+            if (event->len == 0) {
+                continue;
+            }
+
+            auto const name = QFile::decodeName(event->name);
+            auto const ignoreFile = isIgnoreFile(name);
+            if (name.startsWith('.') && !ignoreFile) {
+                continue;
+            }
+            if ((event->mask & IN_CLOSE_WRITE) && !ignoreFile && !reportContentChanges) {
+                // Content changes do not change the listing
+                continue;
+            }
+            changed.insert(dir);
+            if ((event->mask & IN_ISDIR) && (event->mask & (IN_MOVED_FROM | IN_DELETE))) {
+                forgetTree(dir + name + '/');
+            }
+        }
+    }
+
+    if (overflow) {
+        changed.clear();
+        coalesceTimer->stop();
+        emit overflowed();
+        return;
+    }
+    if (!changed.isEmpty() && !coalesceTimer->isActive()) {
+        coalesceTimer->start();
+    }
+#endif
+}
+
+// Drops the watches of a directory and all the directories below it
+auto DirectoryWatcher::forgetTree(const QString &relativeDir) -> void {
+#if defined(Q_OS_LINUX)
+    for (auto it = watchedDirs.begin(); it != watchedDirs.end();) {
+        if (!it.key().startsWith(relativeDir)) {
+            ++it;
+            continue;
+        }
+        ::inotify_rm_watch(fd, it.value());
+        watches.remove(it.value());
+        it = watchedDirs.erase(it);
+    }
+#else
+    Q_UNUSED(relativeDir);
+#endif
+}
+
+auto DirectoryWatcher::flush() -> void {
+    auto dirs = QStringList(changed.cbegin(), changed.cend());
+    changed.clear();
+    // Parents first, so a removed tree is handled once
+    dirs.sort();
+    emit directoriesChanged(dirs);
+}
@@ -0,0 +1,72 @@
+/**
+ * \file DirectoryWatcher.hpp
+ * \brief Watches many directories for added, removed and renamed entries
+ * \author Diego Iastrubni diegoiast@gmail.com
+ */
+
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+#include <QHash>
+#include <QObject>
+#include <QSet>
+#include <QString>
+#include <QStringList>
+
+class QSocketNotifier;
+class QTimer;
+
+/**
+ * Reports which directories of a tree had entries added, removed or renamed.
+ *
+ * On Linux a single inotify descriptor holds all the watches, so watching 100k directories
+ * costs one kernel watch each, and no per path objects like QFileSystemWatcher. Events are
+ * read from the thread the watcher lives in (which needs an event loop), and coalesced: all
+ * the directories which changed within CoalesceDelay are reported at once.
+ *
+ * Hidden entries are ignored, except ignore files (.gitignore, .ignore), whose changes
+ * affect the listing of their directory. Files written in place do not change the listing,
+ * and are only reported when content changes are asked for.
+ *
+ * Where inotify is not available, or the kernel limit of watches is reached, watch()
+ * returns false, and the owner is expected to poll instead.
+ */
+class DirectoryWatcher : public QObject {
+    Q_OBJECT
+  public:
+    static constexpr int CoalesceDelay = 200;
+
+    explicit DirectoryWatcher(const QString &rootDir, QObject *parent = nullptr);
+    ~DirectoryWatcher();
+
+    auto getRootDir() const -> const QString & { return rootDir; }
+    // Also report the directory of files which were written and closed
+    auto setReportContentChanges(bool report) -> void { reportContentChanges = report; }
+    // Changes were seen, and are not reported yet
+    auto hasPendingChanges() const -> bool { return !changed.isEmpty(); }
+    // Adds the directories (relative to the root, empty or ending with '/'). Directories which
+    // are watched already are skipped. Returns false if not all of them could be watched.
+    auto watch(const QStringList &relativeDirs) -> bool;
+    // Reports the directories as changed, with the next batch
+    auto markChanged(const QStringList &relativeDirs) -> void;
+
+  signals:
+    void directoriesChanged(const QStringList &relativeDirs);
+    // Events were lost, the whole tree must be checked again
+    void overflowed();
+
+  private:
+    auto readEvents() -> void;
+    auto forgetTree(const QString &relativeDir) -> void;
+    auto flush() -> void;
+
+    QString rootDir;
+    int fd = -1;
+    QSocketNotifier *notifier = nullptr;
+    QTimer *coalesceTimer = nullptr;
+    QHash<int, QString> watches;
+    QHash<QString, int> watchedDirs;
+    QSet<QString> changed;
+    bool reportContentChanges = false;
+};
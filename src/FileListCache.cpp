@@ -0,0 +1,390 @@
+/**
+ * \file FileListCache.cpp
+ * \brief The files of a directory tree, kept on disk between runs
+ * \author Diego Iastrubni diegoiast@gmail.com
+ */
+
+// SPDX-License-Identifier: MIT
+
+#include <mutex>
+#include <vector>
+
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QSet>
+#include <QStandardPaths>
+
+#include "DirectoryWalker.hpp"
+#include "FileListCache.hpp"
+
+static constexpr auto CacheMagic = quint32(0x4350464c); // "CPFL"
+static constexpr auto CacheVersion = quint32(1);
+
+// Milliseconds since the epoch, or -1 if the file does not exist
+static auto modificationTime(const QString &path) -> int64_t {
+    auto info = QFileInfo(path);
+    if (!info.exists()) {
+        return -1;
+    }
+    return info.lastModified().toMSecsSinceEpoch();
+}
+
+FileListCache::FileListCache(const QString &rootDir)
+    : rootDir(QDir::cleanPath(QDir::fromNativeSeparators(rootDir))) {}
+
+auto FileListCache::getFiles() const -> QStringList {
+    auto files = QStringList();
+    for (auto it = directories.cbegin(); it != directories.cend(); ++it) {
+        for (auto const &name : it->files) {
+            files.append(it.key() + name);
+        }
+    }
+    return files;
+}
+
+auto FileListCache::cacheFileName(const QString &rootDir) -> QString {
+    auto root = QDir::cleanPath(QDir::fromNativeSeparators(rootDir));
+    auto hash = QCryptographicHash::hash(root.toUtf8(), QCryptographicHash::Sha1).toHex();
+    auto dir = QStandardPaths::writableLocation(QStandardPaths::CacheLocation);
+    return QString("%1/filelists/%2.cache").arg(dir, QString::fromLatin1(hash));
+}
+
+auto FileListCache::load(const QString &fileName) -> bool {
+    auto file = QFile(fileName);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+    auto stream = QDataStream(&file);
+    stream.setVersion(QDataStream::Qt_6_0);
+
+    auto magic = quint32();
+    auto version = quint32();
+    auto root = QString();
+    stream >> magic >> version >> root;
+    if (magic != CacheMagic || version != CacheVersion || root != rootDir) {
+        return false;
+    }
+
+    auto loadedIgnores = QHash<QString, int64_t>();
+    auto loadedDirectories = QHash<QString, Directory>();
+    auto count = quint32();
+    stream >> count;
+    for (auto i = quint32(0); i < count && stream.status() == QDataStream::Ok; i++) {
+        auto path = QString();
+        auto modified = qint64();
+        stream >> path >> modified;
+        loadedIgnores.insert(path, modified);
+    }
+    stream >> count;
+    loadedDirectories.reserve(count);
+    for (auto i = quint32(0); i < count && stream.status() == QDataStream::Ok; i++) {
+        auto relativeDir = QString();
+        auto modified = qint64();
+        auto directory = Directory();
+        stream >> relativeDir >> modified >> directory.files >> directory.subDirectories;
+        directory.modified = modified;
+        loadedDirectories.insert(relativeDir, std::move(directory));
+    }
+    if (stream.status() != QDataStream::Ok) {
+        return false;
+    }
+
+    ignoreFiles = std::move(loadedIgnores);
+    directories = std::move(loadedDirectories);
+    return true;
+}
+
+auto FileListCache::save(const QString &fileName) const -> bool {
+    QDir().mkpath(QFileInfo(fileName).path());
+    auto file = QSaveFile(fileName);
+    if (!file.open(QIODevice::WriteOnly)) {
+        return false;
+    }
+    auto stream = QDataStream(&file);
+    stream.setVersion(QDataStream::Qt_6_0);
+
+    stream << CacheMagic << CacheVersion << rootDir;
+    stream << quint32(ignoreFiles.size());
+    for (auto it = ignoreFiles.cbegin(); it != ignoreFiles.cend(); ++it) {
+        stream << it.key() << qint64(it.value());
+    }
+    stream << quint32(directories.size());
+    for (auto it = directories.cbegin(); it != directories.cend(); ++it) {
+        stream << it.key() << qint64(it->modified) << it->files << it->subDirectories;
+    }
+    return stream.status() == QDataStream::Ok && file.commit();
+}
+
+auto FileListCache::ignoreFilesChanged() const -> bool {
+    for (auto it = ignoreFiles.cbegin(); it != ignoreFiles.cend(); ++it) {
+        if (modificationTime(it.key()) != it.value()) {
+            return true;
+        }
+    }
+    return modificationTime(rootDir + "/.git/info/exclude") !=
+           ignoreFiles.value(rootDir + "/.git/info/exclude", -1);
+}
+
+auto FileListCache::refresh(QStringList &added, QStringList &removed,
+                            const std::atomic<bool> &stop, const FilesCallback &onFiles)
+    -> bool {
+    auto const reportFound = onFiles && directories.isEmpty();
+    auto updated = QHash<QString, Directory>();
+    auto updatedIgnores = QHash<QString, int64_t>();
+    auto rulesChanged = false;
+    auto mutex = std::mutex();
+
+    // Directories whose time did not change are taken from `known`, the rest are read.
+    // Called from the walker's threads, so the shared state is guarded by `mutex`.
+    auto scan = [&](const QHash<QString, Directory> &known) {
+        updated.clear();
+        updatedIgnores.clear();
+        rulesChanged = false;
+        auto readTimes = QHash<QString, int64_t>();
+        auto ignoreNames = {QString(".gitignore"), QString(".ignore")};
+
+        auto isKnown = [&](const QString &relativeDir, QStringList &subDirectories) {
+            if (stop) {
+                // Nothing below is walked
+                return true;
+            }
+            auto const dirPath = rootDir + '/' + relativeDir;
+            auto modified = modificationTime(dirPath);
+            auto it = known.constFind(relativeDir);
+            if (it != known.cend() && it->modified == modified) {
+                subDirectories = it->subDirectories;
+                auto lock = std::unique_lock(mutex);
+                updated.insert(relativeDir, *it);
+                for (auto const &name : ignoreNames) {
+                    auto ignoreFile = ignoreFiles.constFind(dirPath + name);
+                    if (ignoreFile != ignoreFiles.cend()) {
+                        updatedIgnores.insert(ignoreFile.key(), ignoreFile.value());
+                    }
+                }
+                return true;
+            }
+
+            // New directories are read whole anyway, but for known ones, new rules may hide
+            // or show files in sub directories which were not read again
+            auto const wasKnown = it != known.cend();
+            auto ignoreTimes = QHash<QString, int64_t>();
+            for (auto const &name : ignoreNames) {
+                ignoreTimes.insert(dirPath + name, modificationTime(dirPath + name));
+            }
+            auto lock = std::unique_lock(mutex);
+            readTimes.insert(relativeDir, modified);
+            for (auto ignore = ignoreTimes.cbegin(); ignore != ignoreTimes.cend(); ++ignore) {
+                auto const &ignoreFile = ignore.key();
+                auto ignoreModified = ignore.value();
+                if (ignoreModified >= 0) {
+                    updatedIgnores.insert(ignoreFile, ignoreModified);
+                }
+                if (wasKnown && ignoreFiles.value(ignoreFile, -1) != ignoreModified) {
+                    rulesChanged = true;
+                }
+            }
+            return false;
+        };
+        auto onListing = [&](DirectoryWalker::DirectoryListing &&listing) {
+            if (stop) {
+                return false;
+            }
+            if (reportFound && !listing.files.isEmpty()) {
+                auto files = listing.files;
+                for (auto &file : files) {
+                    file.prepend(listing.relativeDir);
+                }
+                onFiles(std::move(files));
+            }
+            auto lock = std::unique_lock(mutex);
+            auto modified = readTimes.value(listing.relativeDir);
+            updated.insert(listing.relativeDir, {modified, std::move(listing.files),
+                                                 std::move(listing.subDirectories)});
+            return true;
+        };
+
+        auto walker = DirectoryWalker(rootDir);
+        walker.walkDirectories(onListing, isKnown);
+        return !stop;
+    };
+
+    // A changed ignore file may change what is listed anywhere below it
+    auto const fullScan = ignoreFilesChanged();
+    if (!scan(fullScan ? QHash<QString, Directory>() : directories)) {
+        return false;
+    }
+    if (rulesChanged && !fullScan && !directories.isEmpty()) {
+        if (!scan({})) {
+            return false;
+        }
+    }
+    auto excludeFile = rootDir + "/.git/info/exclude";
+    auto excludeModified = modificationTime(excludeFile);
+    if (excludeModified >= 0) {
+        updatedIgnores.insert(excludeFile, excludeModified);
+    }
+
+    for (auto it = updated.cbegin(); !reportFound && it != updated.cend(); ++it) {
+        auto old = directories.constFind(it.key());
+        if (old == directories.cend()) {
+            for (auto const &name : it->files) {
+                added.append(it.key() + name);
+            }
+            continue;
+        }
+        if (old->files == it->files) {
+            continue;
+        }
+        auto oldFiles = QSet<QString>(old->files.cbegin(), old->files.cend());
+        auto newFiles = QSet<QString>(it->files.cbegin(), it->files.cend());
+        for (auto const &name : it->files) {
+            if (!oldFiles.contains(name)) {
+                added.append(it.key() + name);
+            }
+        }
+        for (auto const &name : old->files) {
+            if (!newFiles.contains(name)) {
+                removed.append(it.key() + name);
+            }
+        }
+    }
+    for (auto it = directories.cbegin(); it != directories.cend(); ++it) {
+        if (!updated.contains(it.key())) {
+            for (auto const &name : it->files) {
+                removed.append(it.key() + name);
+            }
+        }
+    }
+
+    directories = std::move(updated);
+    ignoreFiles = std::move(updatedIgnores);
+    return true;
+}
+
+auto FileListCache::update(const QStringList &changedDirs, QStringList &added,
+                           QStringList &removed, QStringList &newDirectories) -> void {
+    // Parents first: a directory removed with its parent is not looked at again
+    auto dirs = changedDirs;
+    dirs.sort();
+    for (auto const &dir : std::as_const(dirs)) {
+        updateDirectory(dir, added, removed, newDirectories);
+    }
+}
+
+auto FileListCache::updateDirectory(const QString &relativeDir, QStringList &added,
+                                    QStringList &removed, QStringList &newDirectories) -> void {
+    if (!directories.contains(relativeDir)) {
+        // Removed already, or ignored
+        return;
+    }
+    auto const dirPath = rootDir + '/' + relativeDir;
+    if (!QFileInfo(dirPath).isDir()) {
+        removeTree(relativeDir, removed);
+        auto parentEnd = relativeDir.lastIndexOf('/', relativeDir.size() - 2) + 1;
+        auto parent = directories.find(relativeDir.left(parentEnd));
+        if (parent != directories.end()) {
+            parent->subDirectories.removeAll(relativeDir.sliced(parentEnd).chopped(1));
+        }
+        return;
+    }
+
+    // A changed ignore file may hide or show anything below it, so then the whole tree below
+    // is read. Otherwise, only this directory and the new ones below it are.
+    auto rulesChanged = false;
+    for (auto const &name : {QString(".gitignore"), QString(".ignore")}) {
+        auto ignoreFile = dirPath + name;
+        auto modified = modificationTime(ignoreFile);
+        if (modified != ignoreFiles.value(ignoreFile, -1)) {
+            rulesChanged = true;
+        }
+    }
+
+    auto mutex = std::mutex();
+    auto readTimes = QHash<QString, int64_t>();
+    auto readIgnores = QHash<QString, int64_t>();
+    auto listings = std::vector<DirectoryWalker::DirectoryListing>();
+    auto isKnown = [&](const QString &dir, QStringList &) {
+        if (dir != relativeDir && !rulesChanged && directories.contains(dir)) {
+            // Known, and watched on its own
+            return true;
+        }
+        auto path = rootDir + '/' + dir;
+        auto modified = modificationTime(path);
+        auto gitIgnore = modificationTime(path + ".gitignore");
+        auto ignore = modificationTime(path + ".ignore");
+        auto lock = std::unique_lock(mutex);
+        readTimes.insert(dir, modified);
+        readIgnores.insert(path + ".gitignore", gitIgnore);
+        readIgnores.insert(path + ".ignore", ignore);
+        return false;
+    };
+    auto onListing = [&](DirectoryWalker::DirectoryListing &&listing) {
+        listings.push_back(std::move(listing));
+        return true;
+    };
+    auto walker = DirectoryWalker(rootDir);
+    walker.walkDirectories(onListing, isKnown, 0, relativeDir);
+
+    for (auto it = readIgnores.cbegin(); it != readIgnores.cend(); ++it) {
+        if (it.value() < 0) {
+            ignoreFiles.remove(it.key());
+        } else {
+            ignoreFiles.insert(it.key(), it.value());
+        }
+    }
+
+    for (auto &listing : listings) {
+        auto const &dir = listing.relativeDir;
+        auto old = directories.constFind(dir);
+        if (old == directories.cend()) {
+            newDirectories.append(dir);
+            for (auto const &name : std::as_const(listing.files)) {
+                added.append(dir + name);
+            }
+        } else {
+            auto oldFiles = QSet<QString>(old->files.cbegin(), old->files.cend());
+            auto newFiles = QSet<QString>(listing.files.cbegin(), listing.files.cend());
+            for (auto const &name : std::as_const(listing.files)) {
+                if (!oldFiles.contains(name)) {
+                    added.append(dir + name);
+                }
+            }
+            for (auto const &name : old->files) {
+                if (!newFiles.contains(name)) {
+                    removed.append(dir + name);
+                }
+            }
+            auto oldSubDirectories = old->subDirectories;
+            for (auto const &name : std::as_const(oldSubDirectories)) {
+                if (!listing.subDirectories.contains(name)) {
+                    removeTree(dir + name + '/', removed);
+                }
+            }
+        }
+        directories.insert(dir, {readTimes.value(dir), std::move(listing.files),
+                                 std::move(listing.subDirectories)});
+    }
+}
+
+// Forgets a directory and everything below it
+auto FileListCache::removeTree(const QString &relativeDir, QStringList &removed) -> void {
+    for (auto it = directories.begin(); it != directories.end();) {
+        if (!it.key().startsWith(relativeDir)) {
+            ++it;
+            continue;
+        }
+        for (auto const &name : std::as_const(it->files)) {
+            removed.append(it.key() + name);
+        }
+        it = directories.erase(it);
+    }
+    auto const prefix = rootDir + '/' + relativeDir;
+    for (auto it = ignoreFiles.begin(); it != ignoreFiles.end();) {
+        it = it.key().startsWith(prefix) ? ignoreFiles.erase(it) : std::next(it);
+    }
+}
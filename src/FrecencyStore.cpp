@@ -0,0 +1,146 @@
+/**
+ * \file FrecencyStore.cpp
+ * \brief Remembers how often and how recently files were used
+ * \author Diego Iastrubni diegoiast@gmail.com
+ */
+
+// SPDX-License-Identifier: MIT
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include <QDataStream>
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QStandardPaths>
+
+#include "FrecencyStore.hpp"
+
+static constexpr auto StoreMagic = quint32(0x43504652); // "CPFR"
+static constexpr auto StoreVersion = quint32(1);
+
+static auto eventWeight(FrecencyStore::Event event) -> double {
+    switch (event) {
+    case FrecencyStore::Event::Opened:
+        return 2;
+    case FrecencyStore::Event::Activated:
+        return 1;
+    }
+    return 0;
+}
+
+auto FrecencyStore::now() -> int64_t { return QDateTime::currentSecsSinceEpoch(); }
+
+auto FrecencyStore::decayed(const Entry &entry, int64_t when) -> double {
+    auto const days = double(std::max<int64_t>(when - entry.lastUsed, 0)) / (24 * 60 * 60);
+    return entry.score * std::exp2(-days / HalfLifeDays);
+}
+
+auto FrecencyStore::record(const QString &fileName, Event event, int64_t when) -> void {
+    if (fileName.isEmpty()) {
+        return;
+    }
+    auto &entry = entries[QDir::fromNativeSeparators(fileName)];
+    entry.score = decayed(entry, when) + eventWeight(event);
+    entry.lastUsed = when;
+    modified = true;
+    if (entries.size() > MaxEntries) {
+        prune();
+    }
+}
+
+auto FrecencyStore::score(const QString &fileName, int64_t when) const -> double {
+    auto it = entries.constFind(QDir::fromNativeSeparators(fileName));
+    return it == entries.cend() ? 0 : decayed(*it, when);
+}
+
+auto FrecencyStore::scoresUnder(const QString &dir, int64_t when) const
+    -> QHash<QString, double> {
+    auto prefix = QDir::fromNativeSeparators(dir);
+    if (!prefix.endsWith('/')) {
+        prefix += '/';
+    }
+    auto scores = QHash<QString, double>();
+    for (auto it = entries.cbegin(); it != entries.cend(); ++it) {
+        if (it.key().startsWith(prefix)) {
+            scores.insert(it.key().sliced(prefix.size()), decayed(*it, when));
+        }
+    }
+    return scores;
+}
+
+// Drops the lowest scored tenth, so pruning is not needed on every use
+auto FrecencyStore::prune() -> void {
+    auto const when = now();
+    auto scores = std::vector<double>();
+    scores.reserve(entries.size());
+    for (auto const &entry : std::as_const(entries)) {
+        scores.push_back(decayed(entry, when));
+    }
+    auto const keep = size_t(MaxEntries - MaxEntries / 10);
+    std::nth_element(scores.begin(), scores.begin() + (scores.size() - keep), scores.end());
+    auto const threshold = scores[scores.size() - keep];
+    entries.removeIf([&](auto it) { return decayed(it.value(), when) < threshold; });
+}
+
+auto FrecencyStore::defaultFileName() -> QString {
+    auto dir = QStandardPaths::writableLocation(QStandardPaths::AppDataLocation);
+    return dir + "/frecency.dat";
+}
+
+auto FrecencyStore::load(const QString &fileName) -> bool {
+    auto file = QFile(fileName);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+    auto stream = QDataStream(&file);
+    auto magic = quint32();
+    auto version = quint32();
+    stream >> magic >> version;
+    if (magic != StoreMagic || version != StoreVersion) {
+        return false;
+    }
+    auto count = quint32();
+    stream >> count;
+    auto loaded = QHash<QString, Entry>();
+    loaded.reserve(count);
+    for (auto i = quint32(0); i < count && stream.status() == QDataStream::Ok; i++) {
+        auto name = QString();
+        auto entry = Entry();
+        auto lastUsed = qint64();
+        stream >> name >> entry.score >> lastUsed;
+        entry.lastUsed = lastUsed;
+        loaded.insert(name, entry);
+    }
+    if (stream.status() != QDataStream::Ok) {
+        return false;
+    }
+    entries = std::move(loaded);
+    modified = false;
+    return true;
+}
+
+auto FrecencyStore::save(const QString &fileName) -> bool {
+    if (!modified) {
+        return true;
+    }
+    QDir().mkpath(QFileInfo(fileName).absolutePath());
+    auto file = QSaveFile(fileName);
+    if (!file.open(QIODevice::WriteOnly)) {
+        return false;
+    }
+    auto stream = QDataStream(&file);
+    stream << StoreMagic << StoreVersion << quint32(entries.size());
+    for (auto it = entries.cbegin(); it != entries.cend(); ++it) {
+        stream << it.key() << it->score << qint64(it->lastUsed);
+    }
+    if (stream.status() != QDataStream::Ok || !file.commit()) {
+        return false;
+    }
+    modified = false;
+    return true;
+}
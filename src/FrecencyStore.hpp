@@ -0,0 +1,58 @@
+/**
+ * \file FrecencyStore.hpp
+ * \brief Remembers how often and how recently files were used
+ * \author Diego Iastrubni diegoiast@gmail.com
+ */
+
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+#include <cstdint>
+
+#include <QHash>
+#include <QString>
+
+/**
+ * Scores files by frequency and recency ("frecency"): every use adds to the score of a file,
+ * and scores halve every HalfLifeDays, so a file used daily stays ahead of one used many
+ * times last month.
+ *
+ * Only a decayed score and the time of the last use are kept per file, and at most MaxEntries
+ * files (the lowest scores are dropped), so the store stays small. It is saved in a binary
+ * file under the application data directory.
+ */
+class FrecencyStore {
+  public:
+    static constexpr int MaxEntries = 2000;
+    static constexpr double HalfLifeDays = 7;
+
+    enum class Event { Opened, Activated };
+
+    // Seconds since the epoch
+    static auto now() -> int64_t;
+
+    auto record(const QString &fileName, Event event, int64_t when = now()) -> void;
+    auto score(const QString &fileName, int64_t when = now()) const -> double;
+    // The scores of the files in a directory tree, by path relative to it
+    auto scoresUnder(const QString &dir, int64_t when = now()) const -> QHash<QString, double>;
+
+    static auto defaultFileName() -> QString;
+    auto load(const QString &fileName) -> bool;
+    // Does nothing if nothing was recorded since the last load() or save()
+    auto save(const QString &fileName) -> bool;
+
+  private:
+    struct Entry {
+        // As of lastUsed
+        double score = 0;
+        int64_t lastUsed = 0;
+    };
+
+    static auto decayed(const Entry &entry, int64_t when) -> double;
+    auto prune() -> void;
+
+    // By absolute path, using '/'
+    QHash<QString, Entry> entries;
+    bool modified = false;
+};
@@ -0,0 +1,307 @@
+/**
+ * \file FuzzyMatcher.cpp
+ * \brief Scored fuzzy matching of file paths, for quick open
+ * \author Diego Iastrubni diegoiast@gmail.com
+ */
+
+// SPDX-License-Identifier: MIT
+
+#include <algorithm>
+#include <vector>
+
+#include <QtConcurrent/QtConcurrentMap>
+
+#include "FuzzyMatcher.hpp"
+
+static constexpr auto ScoreMatch = 16;
+static constexpr auto BonusBoundary = 10;
+static constexpr auto BonusCamelCase = 8;
+static constexpr auto BonusConsecutive = 8;
+static constexpr auto BonusNameStart = 12;
+static constexpr auto BonusNameOnly = 32;
+static constexpr auto PenaltyGapStart = 3;
+static constexpr auto PenaltyGapExtension = 1;
+static constexpr auto MaxGapPenalty = 12;
+
+static inline auto fold(char16_t c) -> char16_t {
+    if (c < 128) {
+        return c >= 'A' && c <= 'Z' ? char16_t(c + ('a' - 'A')) : c;
+    }
+    return char16_t(QChar::toLower(char32_t(c)));
+}
+
+static inline auto isBoundary(char16_t c) -> bool {
+    return c == '/' || c == '_' || c == '-' || c == '.' || c == ' ';
+}
+
+// dir + name, without joining them
+struct JoinedPath {
+    QStringView dir;
+    QStringView name;
+
+    auto size() const -> qsizetype { return dir.size() + name.size(); }
+    auto at(qsizetype i) const -> char16_t {
+        return i < dir.size() ? dir[i].unicode() : name[i - dir.size()].unicode();
+    }
+};
+
+auto FuzzyMatcher::setCandidates(std::shared_ptr<const PathStore> newPaths,
+                                 const QList<PathStore::FileId> &files,
+                                 const QHash<QString, int> &boosts) -> void {
+    paths = std::move(newPaths);
+    candidates = files;
+    lastQuery.clear();
+    lastMatches.clear();
+    boosted.clear();
+    boostById.clear();
+    if (!paths || boosts.isEmpty()) {
+        return;
+    }
+
+    // The boosts by directory, so most candidates cost a lookup of their directory id
+    auto boostsByDir = QHash<QString, QHash<QString, int>>();
+    for (auto it = boosts.cbegin(); it != boosts.cend(); ++it) {
+        auto const slash = it.key().lastIndexOf('/');
+        boostsByDir[it.key().first(slash + 1)].insert(it.key().sliced(slash + 1), it.value());
+    }
+    auto lock = paths->lockForReading();
+    auto dirBoosts = QHash<uint32_t, const QHash<QString, int> *>();
+    for (auto index = qsizetype(0); index < candidates.size(); index++) {
+        auto const id = candidates[index];
+        if (paths->isRemoved(id)) {
+            continue;
+        }
+        auto const directory = paths->directoryId(id);
+        auto dir = dirBoosts.constFind(directory);
+        if (dir == dirBoosts.cend()) {
+            auto found = boostsByDir.constFind(paths->directoryPath(directory).toString());
+            dir = dirBoosts.insert(directory,
+                                   found == boostsByDir.cend() ? nullptr : &found.value());
+        }
+        if (!*dir) {
+            continue;
+        }
+        auto boost = (*dir)->value(paths->fileName(id).toString());
+        if (boost > 0) {
+            boostById.insert(id, boost);
+            boosted.append(index);
+        }
+    }
+    std::stable_sort(boosted.begin(), boosted.end(), [this](auto a, auto b) {
+        return boostById.value(candidates[a]) > boostById.value(candidates[b]);
+    });
+}
+
+auto FuzzyMatcher::foldQuery(const QString &query) -> QString {
+    auto folded = QString();
+    folded.reserve(query.size());
+    for (auto c : query) {
+        if (c.isSpace()) {
+            continue;
+        }
+        folded.append(c == '\\' ? QChar('/') : QChar(fold(c.unicode())));
+    }
+    return folded;
+}
+
+auto FuzzyMatcher::score(QStringView foldedQuery, QStringView dir, QStringView name) -> int {
+    auto const path = JoinedPath{dir, name};
+    auto const n = path.size();
+    auto const m = foldedQuery.size();
+    if (m == 0) {
+        return 0;
+    }
+
+    // Most candidates are rejected here
+    auto qi = qsizetype(0);
+    for (auto i = qsizetype(0); i < n && qi < m; i++) {
+        if (fold(path.at(i)) == foldedQuery[qi].unicode()) {
+            qi++;
+        }
+    }
+    if (qi < m) {
+        return NoMatch;
+    }
+
+    // The latest window which matches, which favors the file name over the directories
+    auto start = qsizetype(0);
+    qi = m - 1;
+    for (auto i = n - 1; i >= 0; i--) {
+        if (fold(path.at(i)) == foldedQuery[qi].unicode()) {
+            if (qi == 0) {
+                start = i;
+                break;
+            }
+            qi--;
+        }
+    }
+
+    auto total = 0;
+    auto previousMatch = qsizetype(-1);
+    qi = 0;
+    for (auto i = start; i < n && qi < m; i++) {
+        auto const c = path.at(i);
+        if (fold(c) != foldedQuery[qi].unicode()) {
+            continue;
+        }
+        auto s = ScoreMatch;
+        auto const previous = i > 0 ? path.at(i - 1) : char16_t('/');
+        if (isBoundary(previous)) {
+            s += BonusBoundary;
+        } else if (QChar::isLower(previous) && QChar::isUpper(c)) {
+            s += BonusCamelCase;
+        }
+        if (i == dir.size()) {
+            s += BonusNameStart;
+        }
+        if (qi > 0) {
+            auto const gap = i - previousMatch - 1;
+            if (gap == 0) {
+                s += BonusConsecutive;
+            } else {
+                s -= int(std::min<qsizetype>(PenaltyGapStart + PenaltyGapExtension * (gap - 1),
+                                             MaxGapPenalty));
+            }
+        }
+        total += s;
+        previousMatch = i;
+        qi++;
+    }
+    if (start >= dir.size()) {
+        total += BonusNameOnly;
+    }
+    return std::max(total, 0);
+}
+
+namespace {
+struct Scored {
+    int score;
+    qsizetype length;
+    qsizetype index;
+};
+
+// Higher scores first, then shorter paths, then the candidates' order
+inline auto isBetter(const Scored &a, const Scored &b) -> bool {
+    if (a.score != b.score) {
+        return a.score > b.score;
+    }
+    if (a.length != b.length) {
+        return a.length < b.length;
+    }
+    return a.index < b.index;
+}
+
+struct Chunk {
+    qsizetype begin;
+    qsizetype end;
+    std::vector<Scored> found;
+    std::vector<Scored> best;
+};
+} // namespace
+
+auto FuzzyMatcher::match(const QString &query, qsizetype maxResults) -> QList<PathStore::FileId> {
+    auto results = QList<PathStore::FileId>();
+    if (!paths) {
+        return results;
+    }
+    auto lock = paths->lockForReading();
+    auto const folded = foldQuery(query);
+    if (folded.isEmpty()) {
+        lastQuery.clear();
+        lastMatches.clear();
+        for (auto index : std::as_const(boosted)) {
+            if (results.size() == maxResults) {
+                return results;
+            }
+            results.append(candidates[index]);
+        }
+        for (auto id : std::as_const(candidates)) {
+            if (results.size() == maxResults) {
+                break;
+            }
+            if (!paths->isRemoved(id) && !boostById.contains(id)) {
+                results.append(id);
+            }
+        }
+        return results;
+    }
+
+    // Whatever matches the longer query matched the shorter one as well
+    auto const incremental = !lastQuery.isEmpty() && folded.startsWith(lastQuery);
+    auto const count = incremental ? lastMatches.size() : candidates.size();
+    auto chunks = std::vector<Chunk>();
+    for (auto begin = qsizetype(0); begin < count; begin += ChunkSize) {
+        chunks.push_back({begin, std::min(begin + ChunkSize, count), {}, {}});
+    }
+
+    auto const &store = *paths;
+    QtConcurrent::blockingMap(chunks, [&](Chunk &chunk) {
+        for (auto k = chunk.begin; k < chunk.end; k++) {
+            auto const index = incremental ? lastMatches[k] : k;
+            auto const id = candidates[index];
+            if (store.isRemoved(id)) {
+                continue;
+            }
+            auto const dir = store.directoryPath(store.directoryId(id));
+            auto const name = store.fileName(id);
+            auto s = score(folded, dir, name);
+            if (s != NoMatch) {
+                if (!boostById.isEmpty()) {
+                    s += boostById.value(id);
+                }
+                chunk.found.push_back({s, dir.size() + name.size(), index});
+            }
+        }
+        auto const keep = std::min<size_t>(size_t(maxResults), chunk.found.size());
+        chunk.best.resize(keep);
+        std::partial_sort_copy(chunk.found.cbegin(), chunk.found.cend(), chunk.best.begin(),
+                               chunk.best.end(), isBetter);
+    });
+
+    auto best = std::vector<Scored>();
+    lastMatches.clear();
+    for (auto const &chunk : chunks) {
+        best.insert(best.end(), chunk.best.cbegin(), chunk.best.cend());
+        for (auto const &found : chunk.found) {
+            lastMatches.append(found.index);
+        }
+    }
+    lastQuery = folded;
+
+    auto const keep = std::min<size_t>(size_t(maxResults), best.size());
+    std::partial_sort(best.begin(), best.begin() + keep, best.end(), isBetter);
+    results.reserve(keep);
+    for (auto i = size_t(0); i < keep; i++) {
+        results.append(candidates[best[i].index]);
+    }
+    return results;
+}
+
+auto FuzzyMatcher::matchBoosted(const QString &query, qsizetype maxResults)
+    -> QList<PathStore::FileId> {
+    auto results = QList<PathStore::FileId>();
+    if (!paths || boosted.isEmpty()) {
+        return results;
+    }
+    auto lock = paths->lockForReading();
+    auto const folded = foldQuery(query);
+    auto found = std::vector<Scored>();
+    for (auto index : std::as_const(boosted)) {
+        auto const id = candidates[index];
+        if (paths->isRemoved(id)) {
+            continue;
+        }
+        auto const dir = paths->directoryPath(paths->directoryId(id));
+        auto const name = paths->fileName(id);
+        auto s = score(folded, dir, name);
+        if (s != NoMatch) {
+            found.push_back({s + boostById.value(id), dir.size() + name.size(), index});
+        }
+    }
+    auto const keep = std::min<size_t>(size_t(maxResults), found.size());
+    std::partial_sort(found.begin(), found.begin() + keep, found.end(), isBetter);
+    for (auto i = size_t(0); i < keep; i++) {
+        results.append(candidates[found[i].index]);
+    }
+    return results;
+}
@@ -0,0 +1,72 @@
+/**
+ * \file FuzzyMatcher.hpp
+ * \brief Scored fuzzy matching of file paths, for quick open
+ * \author Diego Iastrubni diegoiast@gmail.com
+ */
+
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+#include <memory>
+
+#include <QHash>
+#include <QList>
+#include <QString>
+#include <QStringView>
+
+#include "PathStore.hpp"
+
+/**
+ * Finds the files whose path contains the query as a subsequence, case insensitive, and
+ * returns the best scored ones (similar to fzf and Sublime Text).
+ *
+ * Matched characters score more at the start of a segment (after `/`, `_`, `-`, `.` or a
+ * space, or on a camelCase hump), when consecutive, and at the start of the file name; gaps
+ * cost a little. A match which lies in the file name alone scores a bonus, so `fl` prefers
+ * `FilesList.cpp` over `foo/bar/l.cpp`.
+ *
+ * The candidates are scored in chunks, on the global thread pool, and each chunk keeps its own
+ * top results, which are merged at the end. When the query only grew since the last call, only
+ * the files which matched last time are scored again.
+ *
+ * Files may be boosted (recently used ones, see FrecencyStore): the boost is added to their
+ * score when they match, and they come first for an empty query. matchBoosted() scores only
+ * them, which is cheap enough to show results before match() runs.
+ *
+ * match() may run on another thread, alongside matchBoosted(), but not alongside another
+ * match() or setCandidates().
+ */
+class FuzzyMatcher {
+  public:
+    static constexpr int NoMatch = -1;
+    static constexpr qsizetype ChunkSize = 16384;
+
+    // The files to match, in the order ties are returned. Boosts are by relative path.
+    auto setCandidates(std::shared_ptr<const PathStore> newPaths,
+                       const QList<PathStore::FileId> &files,
+                       const QHash<QString, int> &boosts = {}) -> void;
+    auto getPaths() const -> const std::shared_ptr<const PathStore> & { return paths; }
+
+    // The best `maxResults` files, best first. An empty query returns the first candidates.
+    auto match(const QString &query, qsizetype maxResults) -> QList<PathStore::FileId>;
+    // Like match(), looking only at the boosted files
+    auto matchBoosted(const QString &query, qsizetype maxResults) -> QList<PathStore::FileId>;
+
+    // The query as expected by score()
+    static auto foldQuery(const QString &query) -> QString;
+    // Scores dir + name, or returns NoMatch
+    static auto score(QStringView foldedQuery, QStringView dir, QStringView name) -> int;
+
+  private:
+    std::shared_ptr<const PathStore> paths;
+    QList<PathStore::FileId> candidates;
+
+    // Indexes into candidates, the highest boost first
+    QList<qsizetype> boosted;
+    QHash<PathStore::FileId, int> boostById;
+
+    // Indexes into candidates, of the files which matched the last query
+    QString lastQuery;
+    QList<qsizetype> lastMatches;
+};
@@ -0,0 +1,208 @@
+/**
+ * \file GlobSet.cpp
+ * \brief A set of wildcard patterns, compiled once and matched together
+ * \author Diego Iastrubni diegoiast@gmail.com
+ */
+
+// SPDX-License-Identifier: MIT
+
+#include "GlobSet.hpp"
+
+static auto isWildcard(QChar c) -> bool { return c == '*' || c == '?' || c == '['; }
+
+static auto hasWildcards(QStringView s) -> bool {
+    for (auto c : s) {
+        if (isWildcard(c)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static auto globToRegex(const QString &pattern) -> QString {
+    auto rx = QString();
+    for (auto i = qsizetype(0); i < pattern.size(); i++) {
+        auto c = pattern[i];
+        if (c == '*') {
+            rx += "[^/]*";
+        } else if (c == '?') {
+            rx += "[^/]";
+        } else if (c == '[') {
+            auto end = i + 1;
+            if (end < pattern.size() && (pattern[end] == '!' || pattern[end] == '^')) {
+                end++;
+            }
+            if (end < pattern.size() && pattern[end] == ']') {
+                end++;
+            }
+            end = pattern.indexOf(']', end);
+            if (end < 0) {
+                rx += "\\[";
+                continue;
+            }
+            rx += '[';
+            auto j = i + 1;
+            if (pattern[j] == '!' || pattern[j] == '^') {
+                rx += '^';
+                j++;
+            }
+            for (; j < end; j++) {
+                auto k = pattern[j];
+                if (k == '\\' || k == '[' || k == ']') {
+                    rx += '\\';
+                }
+                rx += k;
+            }
+            rx += ']';
+            i = end;
+        } else {
+            rx += QRegularExpression::escape(QString(c));
+        }
+    }
+    return rx;
+}
+
+GlobSet::GlobSet(const QStringList &patterns, MatchType type, Qt::CaseSensitivity sensitivity)
+    : type(type), sensitivity(sensitivity) {
+    auto residualPatterns = QStringList();
+    for (auto const &pattern : patterns) {
+        addPattern(pattern, residualPatterns);
+    }
+
+    if (!residualPatterns.isEmpty()) {
+        auto rx = "(?:" + residualPatterns.join(")|(?:") + ")";
+        if (type == MatchType::Whole) {
+            rx = QRegularExpression::anchoredPattern(rx);
+        }
+        auto options = QRegularExpression::PatternOptions();
+        if (sensitivity == Qt::CaseInsensitive) {
+            options |= QRegularExpression::CaseInsensitiveOption;
+        }
+        residual.setPattern(rx);
+        residual.setPatternOptions(options);
+        residual.optimize();
+    }
+}
+
+auto GlobSet::splitList(const QString &list) -> QStringList {
+    auto result = QStringList();
+    for (auto const &item : list.split(';', Qt::SkipEmptyParts)) {
+        auto trimmed = item.trimmed();
+        if (!trimmed.isEmpty()) {
+            result.append(trimmed);
+        }
+    }
+    return result;
+}
+
+auto GlobSet::addPattern(const QString &pattern, QStringList &residualPatterns) -> void {
+    if (pattern.isEmpty()) {
+        return;
+    }
+    empty = false;
+    auto fold = [this](const QString &s) {
+        return sensitivity == Qt::CaseInsensitive ? s.toCaseFolded() : s;
+    };
+
+    if (type == MatchType::Anywhere) {
+        // Stars at the ends can match nothing, so they change nothing
+        auto start = qsizetype(0);
+        auto end = pattern.size();
+        while (start < end && pattern[start] == '*') {
+            start++;
+        }
+        while (end > start && pattern[end - 1] == '*') {
+            end--;
+        }
+        auto core = pattern.mid(start, end - start);
+        if (core.isEmpty()) {
+            matchAll = true;
+        } else if (!hasWildcards(core)) {
+            substrings.append(core);
+        } else {
+            residualPatterns.append(globToRegex(core));
+        }
+        return;
+    }
+
+    if (!hasWildcards(pattern)) {
+        names.insert(fold(pattern));
+        return;
+    }
+
+    auto startsWithStar = pattern.startsWith('*');
+    auto endsWithStar = pattern.size() > 1 && pattern.endsWith('*');
+    auto core = QStringView(pattern).sliced(startsWithStar ? 1 : 0);
+    if (endsWithStar) {
+        core.chop(1);
+    }
+    if (hasWildcards(core) || core.contains('/')) {
+        residualPatterns.append(globToRegex(pattern));
+    } else if (startsWithStar && endsWithStar) {
+        substrings.append(core.toString());
+    } else if (startsWithStar) {
+        if (core.startsWith('.') && core.lastIndexOf('.') == 0) {
+            extensions.insert(fold(core.sliced(1).toString()));
+        } else {
+            suffixes.append(core.toString());
+        }
+    } else {
+        prefixes.append(core.toString());
+    }
+}
+
+auto GlobSet::matches(QStringView text) const -> bool {
+    if (matchAll) {
+        return true;
+    }
+    if (empty) {
+        return false;
+    }
+
+    if (type == MatchType::Anywhere) {
+        for (auto const &s : substrings) {
+            if (text.contains(s, sensitivity)) {
+                return true;
+            }
+        }
+        return !residual.pattern().isEmpty() && residual.matchView(text).hasMatch();
+    }
+
+    // A star may not match a '/', so the wildcard part of the text must be free of them
+    auto const size = text.size();
+    auto const firstSlash = text.indexOf('/');
+    auto const lastSlash = text.lastIndexOf('/');
+
+    if (!names.isEmpty() || !extensions.isEmpty()) {
+        auto key = text.toString();
+        if (sensitivity == Qt::CaseInsensitive) {
+            key = std::move(key).toCaseFolded();
+        }
+        if (names.contains(key)) {
+            return true;
+        }
+        auto dot = key.lastIndexOf('.');
+        if (dot >= 0 && (firstSlash < 0 || firstSlash > dot) &&
+            extensions.contains(key.sliced(dot + 1))) {
+            return true;
+        }
+    }
+    for (auto const &p : prefixes) {
+        if (lastSlash < p.size() && text.startsWith(p, sensitivity)) {
+            return true;
+        }
+    }
+    for (auto const &s : suffixes) {
+        if ((firstSlash < 0 || firstSlash >= size - s.size()) && text.endsWith(s, sensitivity)) {
+            return true;
+        }
+    }
+    if (firstSlash < 0) {
+        for (auto const &s : substrings) {
+            if (text.contains(s, sensitivity)) {
+                return true;
+            }
+        }
+    }
+    return !residual.pattern().isEmpty() && residual.matchView(text).hasMatch();
+}
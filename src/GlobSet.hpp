@@ -0,0 +1,55 @@
+/**
+ * \file GlobSet.hpp
+ * \brief A set of wildcard patterns, compiled once and matched together
+ * \author Diego Iastrubni diegoiast@gmail.com
+ */
+
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+#include <QRegularExpression>
+#include <QSet>
+#include <QString>
+#include <QStringList>
+
+/**
+ * Matches a text against a list of wildcard patterns (`*`, `?` and `[...]`, where `*` and
+ * `?` do not match `/`).
+ *
+ * Patterns are sorted by shape when the set is built: plain names and `*.ext` patterns go
+ * into hash sets, `abc*`, `*abc` and `*abc*` become prefix, suffix and substring checks, and
+ * only the remaining patterns are compiled, all together, into one regular expression.
+ *
+ * With MatchType::Anywhere a pattern may match any part of the text, like
+ * QRegularExpression::UnanchoredWildcardConversion does.
+ */
+class GlobSet {
+  public:
+    enum class MatchType { Whole, Anywhere };
+
+    GlobSet() = default;
+    explicit GlobSet(const QStringList &patterns, MatchType type = MatchType::Whole,
+                     Qt::CaseSensitivity sensitivity = Qt::CaseSensitive);
+
+    // Splits a ';' separated list, ignoring empty entries
+    static auto splitList(const QString &list) -> QStringList;
+
+    auto isEmpty() const -> bool { return empty; }
+    auto matches(QStringView text) const -> bool;
+
+  private:
+    auto addPattern(const QString &pattern, QStringList &residualPatterns) -> void;
+
+    MatchType type = MatchType::Whole;
+    Qt::CaseSensitivity sensitivity = Qt::CaseSensitive;
+    bool empty = true;
+    bool matchAll = false;
+
+    QSet<QString> names;
+    QSet<QString> extensions;
+    QStringList prefixes;
+    QStringList suffixes;
+    QStringList substrings;
+    QRegularExpression residual;
+};
@@ -18,6 +18,9 @@ inline constexpr const char *LoadedFile = "LoadedFile";
 // Broadcast - a file has been closed
 inline constexpr const char *ClosedFile = "ClosedFile";
 
+// Broadcast - the tab of a file has been activated. The payload will contain the filename
+inline constexpr const char *ActivatedFile = "ActivatedFile";
+
 // Broadcast - build succeeded.
 inline constexpr const char *BuildFinished = "BuildFinished";
 
@@ -0,0 +1,180 @@
+/**
+ * \file MappedFile.cpp
+ * \brief Read only view of a whole file, memory mapped when it makes sense
+ * \author Diego Iastrubni diegoiast@gmail.com
+ */
+
+// SPDX-License-Identifier: MIT
+
+#include <algorithm>
+#include <cerrno>
+
+#include "MappedFile.hpp"
+
+#if defined(_WIN32) || defined(_WIN64)
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::MappedFile(const std::string &fileName) { open(fileName); }
+
+MappedFile::~MappedFile() { close(); }
+
+void MappedFile::close() {
+    if (mappedData) {
+#if defined(_WIN32) || defined(_WIN64)
+        UnmapViewOfFile(mappedData);
+#else
+        munmap(const_cast<char *>(mappedData), mappedSize);
+#endif
+    }
+    mappedData = nullptr;
+    mappedSize = 0;
+    modified = 0;
+    buffer.clear();
+    opened = false;
+}
+
+#if defined(_WIN32) || defined(_WIN64)
+
+bool MappedFile::open(const std::string &fileName) {
+    close();
+
+    auto length = MultiByteToWideChar(CP_UTF8, 0, fileName.data(), -1, nullptr, 0);
+    auto wideName = std::wstring(length, L'\0');
+    MultiByteToWideChar(CP_UTF8, 0, fileName.data(), -1, wideName.data(), length);
+
+    auto file = CreateFileW(wideName.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE,
+                            nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+
+    auto fileSize = LARGE_INTEGER{};
+    if (!GetFileSizeEx(file, &fileSize)) {
+        fileSize.QuadPart = 0;
+    }
+    auto size = static_cast<size_t>(fileSize.QuadPart);
+
+    // FILETIME counts 100ns intervals since 1601
+    auto writeTime = FILETIME{};
+    if (GetFileTime(file, nullptr, nullptr, &writeTime)) {
+        auto ticks = (static_cast<int64_t>(writeTime.dwHighDateTime) << 32) |
+                     writeTime.dwLowDateTime;
+        modified = (ticks - 116444736000000000LL) / 10000;
+    }
+
+    if (size >= MapThreshold) {
+        auto mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (mapping) {
+            auto view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+            CloseHandle(mapping);
+            if (view) {
+                mappedData = static_cast<const char *>(view);
+                mappedSize = size;
+                CloseHandle(file);
+                opened = true;
+                return true;
+            }
+        }
+    }
+
+    opened = readAll(file, size);
+    CloseHandle(file);
+    return opened;
+}
+
+bool MappedFile::readAll(void *handle, size_t sizeHint) {
+    buffer.resize(sizeHint > 0 ? sizeHint : 64 * 1024);
+    auto total = size_t(0);
+    while (true) {
+        if (total == buffer.size()) {
+            buffer.resize(buffer.size() * 2);
+        }
+        auto chunk = static_cast<DWORD>(std::min<size_t>(buffer.size() - total, 1 << 30));
+        auto bytesRead = DWORD(0);
+        if (!ReadFile(handle, buffer.data() + total, chunk, &bytesRead, nullptr)) {
+            buffer.clear();
+            return false;
+        }
+        if (bytesRead == 0) {
+            break;
+        }
+        total += bytesRead;
+    }
+    buffer.resize(total);
+    return true;
+}
+
+#else
+
+bool MappedFile::open(const std::string &fileName) {
+    close();
+
+    auto fd = ::open(fileName.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return false;
+    }
+
+    struct stat st = {};
+    if (fstat(fd, &st) != 0) {
+        ::close(fd);
+        return false;
+    }
+
+#if defined(__APPLE__)
+    modified = int64_t(st.st_mtimespec.tv_sec) * 1000 + st.st_mtimespec.tv_nsec / 1000000;
+#else
+    modified = int64_t(st.st_mtim.tv_sec) * 1000 + st.st_mtim.tv_nsec / 1000000;
+#endif
+    auto size = S_ISREG(st.st_mode) ? static_cast<size_t>(st.st_size) : size_t(0);
+    if (size >= MapThreshold) {
+        auto p = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (p != MAP_FAILED) {
+            madvise(p, size, MADV_SEQUENTIAL);
+            mappedData = static_cast<const char *>(p);
+            mappedSize = size;
+            ::close(fd);
+            opened = true;
+            return true;
+        }
+    }
+
+    opened = readAll(&fd, size);
+    ::close(fd);
+    return opened;
+}
+
+bool MappedFile::readAll(void *handle, size_t sizeHint) {
+    auto fd = *static_cast<int *>(handle);
+    // One more byte than expected, so a file that matches the size is read in one go,
+    // and EOF is found without another resize
+    buffer.resize(sizeHint > 0 ? sizeHint + 1 : 64 * 1024);
+    auto total = size_t(0);
+    while (true) {
+        if (total == buffer.size()) {
+            buffer.resize(buffer.size() * 2);
+        }
+        auto bytesRead = ::read(fd, buffer.data() + total, buffer.size() - total);
+        if (bytesRead < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            buffer.clear();
+            return false;
+        }
+        if (bytesRead == 0) {
+            break;
+        }
+        total += static_cast<size_t>(bytesRead);
+    }
+    buffer.resize(total);
+    return true;
+}
+
+#endif
@@ -0,0 +1,56 @@
+/**
+ * \file MappedFile.hpp
+ * \brief Read only view of a whole file, memory mapped when it makes sense
+ * \author Diego Iastrubni diegoiast@gmail.com
+ */
+
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+/**
+ * Gives the content of a file as one contiguous buffer.
+ *
+ * Large regular files are memory mapped. Small files, special files (pipes, /proc) and files
+ * which fail to map are read with a single read loop into an internal buffer. The buffer is
+ * kept between calls to open(), so reusing the same object for many files does not allocate.
+ *
+ * Note: if a mapped file is truncated by another process while being read, the OS may
+ * raise SIGBUS. The mapping threshold keeps this to large files only.
+ */
+class MappedFile {
+  public:
+    static constexpr size_t MapThreshold = 256 * 1024;
+
+    MappedFile() = default;
+    explicit MappedFile(const std::string &fileName);
+    ~MappedFile();
+
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    bool open(const std::string &fileName);
+    void close();
+
+    bool isOpen() const { return opened; }
+    bool isMapped() const { return mappedData != nullptr; }
+    const char *data() const { return mappedData ? mappedData : buffer.data(); }
+    size_t size() const { return mappedData ? mappedSize : buffer.size(); }
+    std::string_view view() const { return {data(), size()}; }
+    // Milliseconds since the epoch, as found when the file was opened
+    int64_t lastModified() const { return modified; }
+
+  private:
+    bool readAll(void *handle, size_t sizeHint);
+
+    bool opened = false;
+    const char *mappedData = nullptr;
+    size_t mappedSize = 0;
+    int64_t modified = 0;
+    std::string buffer;
+};
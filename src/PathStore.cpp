@@ -0,0 +1,120 @@
+/**
+ * \file PathStore.cpp
+ * \brief Compact storage of many relative paths, addressed by 32 bit ids
+ * \author Diego Iastrubni diegoiast@gmail.com
+ */
+
+// SPDX-License-Identifier: MIT
+
+#include <array>
+#include <mutex>
+
+#include "PathStore.hpp"
+
+// Compares a1 + a2 with b1 + b2, case insensitive, without joining them
+static auto compareJoined(QStringView a1, QStringView a2, QStringView b1, QStringView b2) -> int {
+    auto a = std::array{a1, a2};
+    auto b = std::array{b1, b2};
+    auto ai = size_t(0);
+    auto bi = size_t(0);
+    while (true) {
+        while (ai < a.size() && a[ai].isEmpty()) {
+            ai++;
+        }
+        while (bi < b.size() && b[bi].isEmpty()) {
+            bi++;
+        }
+        if (ai == a.size() || bi == b.size()) {
+            return (ai == a.size() ? 0 : 1) - (bi == b.size() ? 0 : 1);
+        }
+        auto n = std::min(a[ai].size(), b[bi].size());
+        auto c = a[ai].first(n).compare(b[bi].first(n), Qt::CaseInsensitive);
+        if (c != 0) {
+            return c;
+        }
+        a[ai] = a[ai].sliced(n);
+        b[bi] = b[bi].sliced(n);
+    }
+}
+
+auto PathStore::add(const QString &relativePath) -> FileId {
+    auto lock = std::unique_lock(mutex);
+    return addLocked(relativePath);
+}
+
+auto PathStore::add(const QStringList &relativePaths) -> QList<FileId> {
+    auto ids = QList<FileId>();
+    ids.reserve(relativePaths.size());
+    auto lock = std::unique_lock(mutex);
+    for (auto const &relativePath : relativePaths) {
+        ids.append(addLocked(relativePath));
+    }
+    return ids;
+}
+
+auto PathStore::addLocked(QStringView relativePath) -> FileId {
+    auto const slash = relativePath.lastIndexOf('/');
+    auto const dir = relativePath.first(slash + 1);
+    auto const name = relativePath.sliced(slash + 1);
+
+    auto it = directoryIds.constFind(dir.toString());
+    if (it == directoryIds.cend()) {
+        directories.append(dir.toString());
+        it = directoryIds.insert(directories.last(), uint32_t(directories.size() - 1));
+    }
+    entries.append({it.value(), uint32_t(names.size()), uint32_t(name.size())});
+    names.append(name);
+    return FileId(entries.size() - 1);
+}
+
+// Removing is rare (files deleted while the project is open), a linear scan is fine
+auto PathStore::remove(const QSet<QString> &relativePaths) -> QList<FileId> {
+    auto removedIds = QList<FileId>();
+    auto lock = std::unique_lock(mutex);
+    auto wanted = QHash<uint32_t, QSet<QString>>();
+    for (auto const &relativePath : relativePaths) {
+        auto const slash = relativePath.lastIndexOf('/');
+        auto it = directoryIds.constFind(relativePath.first(slash + 1));
+        if (it != directoryIds.cend()) {
+            wanted[it.value()].insert(relativePath.sliced(slash + 1));
+        }
+    }
+    if (wanted.isEmpty()) {
+        return removedIds;
+    }
+    for (auto id = FileId(0); id < FileId(entries.size()); id++) {
+        auto &entry = entries[id];
+        auto dir = wanted.constFind(entry.directory);
+        if (dir == wanted.cend() || !dir->contains(fileName(id).toString())) {
+            continue;
+        }
+        entry.directory = Removed;
+        removedIds.append(id);
+    }
+    return removedIds;
+}
+
+auto PathStore::path(FileId id) const -> QString {
+    auto const &entry = entries[id];
+    auto const name = fileName(id);
+    if (entry.directory == Removed) {
+        return name.toString();
+    }
+    return directories[entry.directory] + name;
+}
+
+auto PathStore::lessThan(FileId a, FileId b) const -> bool {
+    auto const &entryA = entries[a];
+    auto const &entryB = entries[b];
+    if (entryA.directory == entryB.directory) {
+        return fileName(a).compare(fileName(b), Qt::CaseInsensitive) < 0;
+    }
+    auto dirA = entryA.directory == Removed ? QStringView() : directoryPath(entryA.directory);
+    auto dirB = entryB.directory == Removed ? QStringView() : directoryPath(entryB.directory);
+    return lessThan(dirA, fileName(a), dirB, fileName(b));
+}
+
+auto PathStore::lessThan(QStringView directoryA, QStringView nameA, QStringView directoryB,
+                         QStringView nameB) -> bool {
+    return compareJoined(directoryA, nameA, directoryB, nameB) < 0;
+}
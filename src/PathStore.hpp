@@ -0,0 +1,79 @@
+/**
+ * \file PathStore.hpp
+ * \brief Compact storage of many relative paths, addressed by 32 bit ids
+ * \author Diego Iastrubni diegoiast@gmail.com
+ */
+
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+#include <cstdint>
+#include <shared_mutex>
+
+#include <QHash>
+#include <QList>
+#include <QSet>
+#include <QString>
+#include <QStringList>
+#include <QStringView>
+
+/**
+ * Keeps the files of a tree as (directory, name) pairs. Each directory path is stored once,
+ * and the names of all the files go into one UTF-16 arena, so a file costs 12 bytes plus its
+ * name, instead of a QString of its full path.
+ *
+ * Files are addressed by FileId, which stay valid until the store is destroyed: removed files
+ * leave a hole. Paths are materialised only by path().
+ *
+ * Files are added and removed from one thread. Other threads may read concurrently while
+ * holding lockForReading(), the writing thread itself does not need to lock for reading.
+ */
+class PathStore {
+  public:
+    using FileId = uint32_t;
+
+    // Relative paths, using '/'
+    auto add(const QString &relativePath) -> FileId;
+    auto add(const QStringList &relativePaths) -> QList<FileId>;
+    // Returns the ids of the files which were found
+    auto remove(const QSet<QString> &relativePaths) -> QList<FileId>;
+
+    auto lockForReading() const -> std::shared_lock<std::shared_mutex> {
+        return std::shared_lock(mutex);
+    }
+
+    auto size() const -> qsizetype { return entries.size(); }
+    auto isRemoved(FileId id) const -> bool { return entries[id].directory == Removed; }
+    auto path(FileId id) const -> QString;
+    auto fileName(FileId id) const -> QStringView {
+        auto const &entry = entries[id];
+        return QStringView(names).sliced(entry.nameOffset, entry.nameLength);
+    }
+    // Directories are numbered as well: empty for the root, otherwise ending with '/'
+    auto directoryId(FileId id) const -> uint32_t { return entries[id].directory; }
+    auto directoryPath(uint32_t directory) const -> QStringView { return directories[directory]; }
+
+    // Case insensitive order of the full paths, like QString::compare()
+    auto lessThan(FileId a, FileId b) const -> bool;
+    // The same order, for paths copied out of the store
+    static auto lessThan(QStringView directoryA, QStringView nameA, QStringView directoryB,
+                         QStringView nameB) -> bool;
+
+  private:
+    static constexpr auto Removed = uint32_t(-1);
+
+    struct Entry {
+        uint32_t directory;
+        uint32_t nameOffset;
+        uint32_t nameLength;
+    };
+
+    auto addLocked(QStringView relativePath) -> FileId;
+
+    mutable std::shared_mutex mutex;
+    QList<Entry> entries;
+    QString names;
+    QStringList directories;
+    QHash<QString, uint32_t> directoryIds;
+};
@@ -0,0 +1,206 @@
+/**
+ * \file TextClassifier.cpp
+ * \brief Tells text files from binary ones
+ * \author Diego Iastrubni diegoiast@gmail.com
+ */
+
+// SPDX-License-Identifier: MIT
+
+#include <algorithm>
+#include <cstring>
+#include <mutex>
+#include <shared_mutex>
+
+#include <QDateTime>
+#include <QFile>
+#include <QFileInfo>
+#include <QHash>
+
+#include "TextClassifier.hpp"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define TEXT_CLASSIFIER_SSE2
+#include <emmintrin.h>
+#endif
+
+// The cache is dropped as a whole when it grows past this
+static constexpr auto MaxCachedFiles = 200'000;
+
+namespace {
+
+struct CachedClassification {
+    int64_t size = 0;
+    int64_t modificationTime = 0;
+    bool isText = false;
+};
+
+struct ClassificationCache {
+    std::shared_mutex mutex;
+    QHash<QString, CachedClassification> files;
+};
+
+} // namespace
+
+static auto cache() -> ClassificationCache & {
+    static auto instance = ClassificationCache();
+    return instance;
+}
+
+// Tab, new line, vertical tab, form feed, carriage return and escape (for ANSI colored logs)
+static auto isTextControl(uint8_t c) -> bool { return (c >= 0x09 && c <= 0x0d) || c == 0x1b; }
+
+// Returns the length of the valid UTF-8 sequence at p, or 0. Sets `truncated` if the
+// sequence is cut by the end of the data.
+static auto utf8SequenceLength(const uint8_t *p, const uint8_t *end, bool &truncated) -> size_t {
+    auto c = p[0];
+    auto length = size_t(0);
+    auto low = uint8_t(0x80);
+    auto high = uint8_t(0xbf);
+    if (c >= 0xc2 && c <= 0xdf) {
+        length = 2;
+    } else if (c >= 0xe0 && c <= 0xef) {
+        length = 3;
+        // No overlong forms, and no surrogates
+        low = c == 0xe0 ? 0xa0 : 0x80;
+        high = c == 0xed ? 0x9f : 0xbf;
+    } else if (c >= 0xf0 && c <= 0xf4) {
+        length = 4;
+        low = c == 0xf0 ? 0x90 : 0x80;
+        high = c == 0xf4 ? 0x8f : 0xbf;
+    } else {
+        return 0;
+    }
+
+    for (auto i = size_t(1); i < length; i++) {
+        if (p + i >= end) {
+            truncated = true;
+            return 0;
+        }
+        auto limitLow = i == 1 ? low : uint8_t(0x80);
+        auto limitHigh = i == 1 ? high : uint8_t(0xbf);
+        if (p[i] < limitLow || p[i] > limitHigh) {
+            return 0;
+        }
+    }
+    return length;
+}
+
+// Skips plain printable ASCII, which is most of any text file, a block at a time
+static auto skipPrintableAscii(const uint8_t *p, const uint8_t *end) -> const uint8_t * {
+#if defined(TEXT_CLASSIFIER_SSE2)
+    // As signed bytes, both control chars and bytes with the high bit set are below 0x20
+    auto const limit = _mm_set1_epi8(0x20);
+    while (end - p >= 16) {
+        auto block = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+        if (_mm_movemask_epi8(_mm_cmplt_epi8(block, limit)) != 0) {
+            break;
+        }
+        p += 16;
+    }
+#else
+    constexpr auto highBits = uint64_t(0x8080808080808080);
+    constexpr auto spaces = uint64_t(0x2020202020202020);
+    while (end - p >= 8) {
+        auto word = uint64_t(0);
+        std::memcpy(&word, p, sizeof(word));
+        // Any byte with the high bit set, or below 0x20
+        if (((word | ((word - spaces) & ~word)) & highBits) != 0) {
+            break;
+        }
+        p += 8;
+    }
+#endif
+    return p;
+}
+
+auto TextClassifier::isText(std::string_view data) -> bool {
+    auto const probeSize = std::min(data.size(), ProbeSize);
+    if (probeSize == 0) {
+        return true;
+    }
+    if (std::memchr(data.data(), '\0', probeSize)) {
+        return false;
+    }
+
+    auto p = reinterpret_cast<const uint8_t *>(data.data());
+    auto const end = p + probeSize;
+    auto suspicious = size_t(0);
+    while (p < end) {
+        p = skipPrintableAscii(p, end);
+        if (p >= end) {
+            break;
+        }
+        auto c = *p;
+        if (c < 0x80) {
+            if (c < 0x20 && !isTextControl(c)) {
+                suspicious++;
+            }
+            p++;
+            continue;
+        }
+        auto truncated = false;
+        auto length = utf8SequenceLength(p, end, truncated);
+        if (truncated && probeSize < data.size()) {
+            // Cut by the probe, not by the data
+            break;
+        }
+        if (length == 0) {
+            suspicious++;
+            length = 1;
+        }
+        p += length;
+    }
+    return suspicious * 10 <= probeSize;
+}
+
+static auto findCached(const QString &fileName, int64_t size, int64_t modificationTime,
+                       bool &isText) -> bool {
+    auto &c = cache();
+    auto lock = std::shared_lock(c.mutex);
+    auto it = c.files.constFind(fileName);
+    if (it == c.files.cend() || it->size != size || it->modificationTime != modificationTime) {
+        return false;
+    }
+    isText = it->isText;
+    return true;
+}
+
+static auto storeCached(const QString &fileName, int64_t size, int64_t modificationTime,
+                        bool isText) -> void {
+    auto &c = cache();
+    auto lock = std::unique_lock(c.mutex);
+    if (c.files.size() >= MaxCachedFiles) {
+        c.files.clear();
+    }
+    c.files.insert(fileName, {size, modificationTime, isText});
+}
+
+auto TextClassifier::isTextFile(const QString &fileName, int64_t modificationTime,
+                                std::string_view data) -> bool {
+    auto size = static_cast<int64_t>(data.size());
+    auto result = false;
+    if (!findCached(fileName, size, modificationTime, result)) {
+        result = isText(data);
+        storeCached(fileName, size, modificationTime, result);
+    }
+    return result;
+}
+
+auto TextClassifier::isTextFile(const QString &fileName) -> bool {
+    auto info = QFileInfo(fileName);
+    auto size = info.size();
+    auto modificationTime = info.lastModified().toMSecsSinceEpoch();
+    auto result = false;
+    if (findCached(fileName, size, modificationTime, result)) {
+        return result;
+    }
+
+    auto file = QFile(fileName);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+    auto probe = file.read(ProbeSize);
+    result = isText({probe.constData(), static_cast<size_t>(probe.size())});
+    storeCached(fileName, size, modificationTime, result);
+    return result;
+}
@@ -0,0 +1,40 @@
+/**
+ * \file TextClassifier.hpp
+ * \brief Tells text files from binary ones
+ * \author Diego Iastrubni diegoiast@gmail.com
+ */
+
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+#include <QString>
+
+/**
+ * Decides if a file is text, by looking at its first ProbeSize bytes only.
+ *
+ * A NUL byte means binary. Otherwise, control characters (other than white space and
+ * escape) and bytes which are not part of a valid UTF-8 sequence are counted as suspicious,
+ * and the data is text if no more than 1 in 10 bytes are suspicious. This keeps legacy 8 bit
+ * encodings as text, while compressed or packed data without NUL bytes is still binary.
+ *
+ * Results for files are remembered per file name, size and modification time, so a file is
+ * classified only once until it changes. All functions are thread safe.
+ */
+class TextClassifier {
+  public:
+    static constexpr size_t ProbeSize = 8 * 1024;
+
+    static auto isText(std::string_view data) -> bool;
+
+    // For content already in memory, `modificationTime` is in ms since the epoch
+    static auto isTextFile(const QString &fileName, int64_t modificationTime,
+                           std::string_view data) -> bool;
+
+    // Reads the start of the file, unless the answer is already known
+    static auto isTextFile(const QString &fileName) -> bool;
+};
@@ -16,6 +16,7 @@
 #include "pluginmanager.h"
 #include "plugins/CTags/CTagsPlugin.hpp"
 #include "plugins/ProjectManager/ProjectManagerPlg.h"
+#include "plugins/ProjectManager/SearchCommandLine.h"
 #include "plugins/SplitTabsPlugin/SplitTabsPlugin.hpp"
 #include "plugins/Terminal/TerminalPlugin.hpp"
 #include "plugins/filesystem/filesystembrowser.h"
@@ -29,6 +30,11 @@ int main(int argc, char *argv[]) {
     Q_INIT_RESOURCE(qutepart_syntax_files);
     Q_INIT_RESOURCE(qutepart_theme_data);
 
+    // Searching from the command line needs no GUI, and no display
+    if (isSearchCommandLine(argc, argv)) {
+        return runSearchCommandLine(argc, argv);
+    }
+
     QApplication app(argc, argv);
     QCoreApplication::setApplicationName(CODEPOINTER_APP_NAME);
     QCoreApplication::setApplicationVersion("0.1.1");
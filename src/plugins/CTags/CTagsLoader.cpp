@@ -5,8 +5,8 @@
 #include <cstdio>
 #include <cstdlib>
 #include <filesystem>
-#include <fstream>
 #include <iostream>
+#include <limits>
 #include <sstream>
 #include <string>
 #include <string_view>
@@ -26,11 +26,7 @@
 
 CTagsLoader::CTagsLoader(const std::string &ctagsBinary) : ctagsBinary(ctagsBinary) {}
 
-bool CTagsLoader::loadFile(const std::string &file) {
-    filename = file;
-    tags.clear();
-    return load();
-}
+bool CTagsLoader::loadFile(const std::string &file) { return load(file); }
 
 bool CTagsLoader::scanFiles(const std::vector<std::string> &files) {
     std::string command = ctagsBinary + " -x ";
@@ -51,7 +47,7 @@ bool CTagsLoader::scanFiles(const std::string &ctagsFileName,
         std::cerr << "Error: Failed to generate ctags file." << std::endl;
         return false;
     }
-    bool result = loadFile(ctagsFileName);
+    bool result = load(ctagsFileName, true);
     std::filesystem::remove(ctagsFileName);
     return result;
 }
@@ -63,8 +59,12 @@ bool CTagsLoader::scanDirs(const std::string &dir) {
 }
 
 bool CTagsLoader::scanDirs(const std::string &ctagsFileName, const std::string &dir) {
+    // The current tags file may be mapped: ctags writes a new file, which replaces it, so the
+    // mapped one is never truncated under our feet. The new tags are loaded on this thread,
+    // and replace the current ones when ready.
     std::string logFile = ctagsFileName + ".log";
-    std::string command = ctagsBinary + " -R -f \"" + ctagsFileName + "\" \"" + dir + "\"";
+    std::string newFileName = ctagsFileName + ".new";
+    std::string command = ctagsBinary + " -R -f \"" + newFileName + "\" \"" + dir + "\"";
 
     // std::cerr << command;
     std::thread([=, this]() {
@@ -90,45 +90,101 @@ bool CTagsLoader::scanDirs(const std::string &ctagsFileName, const std::string &
             std::cerr << "CTagsLoader::scanDirs: Failed to generate ctags file." << std::endl;
         }
 #endif
-        loadFile(ctagsFileName);
+#if defined(_WIN32) || defined(_WIN64)
+        // A mapped file cannot be replaced, and a lookup may still hold the current tags
+        // for a moment
+        clear();
+        auto const attempts = 10;
+#else
+        auto const attempts = 1;
+#endif
+        auto error = std::error_code();
+        for (auto attempt = 0; attempt < attempts; attempt++) {
+            std::filesystem::rename(newFileName, ctagsFileName, error);
+            if (!error) {
+                break;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        }
+        if (error) {
+            std::cerr << "CTagsLoader::scanDirs: Failed to replace " << ctagsFileName << ": "
+                      << error.message() << std::endl;
+        }
+        load(ctagsFileName);
     }).detach();
 
     return true;
 }
 
-CTagsLoader::TagListRef CTagsLoader::findTags(const std::string &symbolName,
-                                              bool exactMatch) const {
-    std::vector<std::reference_wrapper<const CTag>> foundTags;
-    std::string symbolLower = symbolName;
-    std::transform(symbolLower.begin(), symbolLower.end(), symbolLower.begin(), ::tolower);
+static inline unsigned char foldCase(char c) {
+    return c >= 'A' && c <= 'Z' ? c + ('a' - 'A') : c;
+}
+
+// Compares as the lower cased strings would, without making them
+static int compareFolded(std::string_view a, std::string_view b) {
+    auto const length = std::min(a.size(), b.size());
+    for (size_t i = 0; i < length; i++) {
+        auto const ca = foldCase(a[i]);
+        auto const cb = foldCase(b[i]);
+        if (ca != cb) {
+            return ca < cb ? -1 : 1;
+        }
+    }
+    return a.size() == b.size() ? 0 : (a.size() < b.size() ? -1 : 1);
+}
+
+static bool startsWithFolded(std::string_view name, std::string_view prefix) {
+    return name.size() >= prefix.size() &&
+           compareFolded(name.substr(0, prefix.size()), prefix) == 0;
+}
+
+// The first 8 lower cased bytes, first byte highest, so keys order like compareFolded does
+// (names hold no '\0'). Only names sharing the key need a full compare.
+static uint64_t foldedPrefix(std::string_view name) {
+    uint64_t key = 0;
+    for (size_t i = 0; i < sizeof(key); i++) {
+        key = (key << 8) | (i < name.size() ? foldCase(name[i]) : 0);
+    }
+    return key;
+}
+
+// Calls job(0) .. job(count - 1), each on its own thread, job(0) on the calling one
+template <typename Job>
+static void runParallel(size_t count, Job &&job) {
+    auto workers = std::vector<std::thread>();
+    for (size_t i = 1; i < count; i++) {
+        workers.emplace_back([&job, i]() { job(i); });
+    }
+    if (count > 0) {
+        job(0);
+    }
+    for (auto &worker : workers) {
+        worker.join();
+    }
+}
+
+CTagsLoader::TagList CTagsLoader::findTags(const std::string &symbolName,
+                                           bool exactMatch) const {
+    auto tagData = currentData();
+    TagList foundTags{tagData, {}};
 
     using namespace std::chrono;
     auto start = steady_clock::now();
 
-    if (symbolName.length() >= 3) {
-        if (exactMatch) {
-            auto comp = [](const CTag &tag, const std::string &name) { return tag.name < name; };
-            auto it = std::lower_bound(tags.begin(), tags.end(), symbolName, comp);
-            while (it != tags.end() && it->name == symbolName) {
-                foundTags.emplace_back(*it);
-                ++it;
+    if (tagData && symbolName.length() >= 3) {
+        // The matches are a range of the folded order, exact ones are among the equal names
+        auto const &order = tagData->foldedOrder;
+        auto i = std::partition_point(order.begin(), order.end(), [&](uint32_t tag) {
+            return compareFolded(tagData->tagName(tag), symbolName) < 0;
+        });
+        for (; i != order.end(); ++i) {
+            auto name = tagData->tagName(*i);
+            if (exactMatch ? compareFolded(name, symbolName) != 0
+                           : !startsWithFolded(name, symbolName)) {
+                break;
             }
-        } else {
-            auto it = std::lower_bound(tags.begin(), tags.end(), symbolLower,
-                                       [](const CTag &tag, const std::string &prefix) {
-                                           auto tagLower = std::string(tag.name);
-                                           std::transform(tagLower.begin(), tagLower.end(),
-                                                          tagLower.begin(), ::tolower);
-                                           return tagLower < prefix;
-                                       });
-
-            for (; it != tags.end(); ++it) {
-
-                auto tagLower = std::string(it->name);
-                std::transform(tagLower.begin(), tagLower.end(), tagLower.begin(), ::tolower);
-                if (tagLower.starts_with(symbolLower)) {
-                    foundTags.emplace_back(*it);
-                }
+            if (!exactMatch || name == symbolName) {
+                foundTags.tags.push_back(tagData->tagAt(*i));
             }
         }
     }
@@ -140,87 +196,119 @@ CTagsLoader::TagListRef CTagsLoader::findTags(const std::string &symbolName,
     return foundTags;
 }
 
+size_t CTagsLoader::size() const {
+    auto tagData = currentData();
+    return tagData ? tagData->size() : 0;
+}
+
 void CTagsLoader::setCTagsBinary(const std::string &newCtagsBinary) {
     this->ctagsBinary = newCtagsBinary;
 }
 
-void CTagsLoader::clear() { tags.clear(); }
+// Lookups which are running keep the tags they use, until they are done
+void CTagsLoader::clear() { setData(nullptr); }
 
-bool CTagsLoader::load() {
+std::shared_ptr<const CTagsLoader::TagData> CTagsLoader::currentData() const {
+    std::lock_guard lock(mutex);
+    return data;
+}
+
+void CTagsLoader::setData(std::shared_ptr<const TagData> newData) {
+    std::lock_guard lock(mutex);
+    data.swap(newData);
+    // The old tags are released outside the lock, by newData
+}
+
+bool CTagsLoader::load(const std::string &fileName, bool copy) {
     using namespace std::chrono;
     auto start = steady_clock::now();
 
-    std::ifstream file(filename);
-    if (!file.is_open()) {
-        std::cerr << "CTagsLoader::load Error: Could not open file " << filename << std::endl;
+    // The file is mapped, or read in one go, and the tags point into it
+    auto newData = std::make_shared<TagData>();
+    auto &mappedFile = newData->mappedFile;
+    if (!mappedFile.open(fileName)) {
+        std::cerr << "CTagsLoader::load Error: Could not open file " << fileName << std::endl;
+        clear();
         return false;
     }
+    if (mappedFile.size() > std::numeric_limits<uint32_t>::max()) {
+        std::cerr << "CTagsLoader::load Error: File is too large " << fileName << std::endl;
+        clear();
+        return false;
+    }
+    auto &text = newData->text;
+    if (copy) {
+        newData->ownedText.assign(mappedFile.view());
+        mappedFile.close();
+        text = newData->ownedText;
+    } else {
+        text = mappedFile.view();
+    }
 
-    tags.clear();
-    // tags.reserve(500000); // Adjust based on expected file size
-
-    std::string line;
-    size_t count = 0;
+    // The pseudo tags (!_TAG_...) are all at the top, sorted before any real tag
+    size_t position = 0;
+    while (position < text.size() && text[position] == '!') {
+        auto newLine = text.find('\n', position);
+        position = newLine == std::string_view::npos ? text.size() : newLine + 1;
+    }
 
-    while (std::getline(file, line)) {
-        if (line.empty() || line[0] == '!') {
-            continue;
+    // Each thread indexes a chunk of whole lines, the chunks are appended in order so the
+    // tags stay sorted
+    auto const remaining = text.size() - position;
+    auto const threads = std::max<size_t>(std::thread::hardware_concurrency(), 1);
+    auto const chunkCount = std::clamp<size_t>(remaining / MinChunkSize, 1, threads);
+    auto chunkStarts = std::vector<size_t>{position};
+    for (size_t i = 1; i < chunkCount; i++) {
+        auto newLine = text.find('\n', std::max(position + remaining * i / chunkCount,
+                                                chunkStarts.back()));
+        if (newLine == std::string_view::npos) {
+            break;
         }
-
-        tags.emplace_back(); // add a new empty CTag
-        CTag &tag = tags.back();
-
-        tag.originalLine = std::move(line); // store original line
-        std::string_view sv(tag.originalLine);
-
-        size_t tab1 = sv.find('\t');
-        if (tab1 == std::string_view::npos) {
-            tags.pop_back();
-            continue;
+        chunkStarts.push_back(newLine + 1);
+    }
+    chunkStarts.push_back(text.size());
+
+    auto &tags = newData->tags;
+    if (chunkStarts.size() == 2) {
+        tags.indexLines(text, chunkStarts[0], chunkStarts[1]);
+    } else {
+        auto chunks = std::vector<TagColumns>(chunkStarts.size() - 1);
+        runParallel(chunks.size(), [&](size_t i) {
+            chunks[i].indexLines(text, chunkStarts[i], chunkStarts[i + 1]);
+        });
+
+        size_t count = 0;
+        for (auto const &chunk : chunks) {
+            count += chunk.lineStarts.size();
         }
-
-        size_t tab2 = sv.find('\t', tab1 + 1);
-        if (tab2 == std::string_view::npos) {
-            tags.pop_back();
-            continue;
+        tags.reserve(count);
+        for (auto const &chunk : chunks) {
+            tags.append(chunk);
         }
-
-        size_t tab3 = sv.find('\t', tab2 + 1);
-
-        tag.name = sv.substr(0, tab1);
-        tag.file = sv.substr(tab1 + 1, tab2 - tab1 - 1);
-        tag.address = sv.substr(
-            tab2 + 1, (tab3 == std::string_view::npos ? std::string_view::npos : tab3 - tab2 - 1));
-
-        tag.fieldKey = TagFieldKey::Unknown;
-        if (tab3 != std::string_view::npos) {
-            size_t tab4 = sv.find('\t', tab3 + 1);
-            std::string_view field =
-                sv.substr(tab3 + 1, (tab4 == std::string_view::npos ? std::string_view::npos
-                                                                    : tab4 - tab3 - 1));
-
-            if (!field.empty()) {
-                tag.fieldKey = mapCharToTagFieldKey(field[0]);
-                if (tab4 != std::string_view::npos && tab4 + 1 < sv.size()) {
-                    tag.fieldValue = sv.substr(tab4 + 1);
-                }
-            }
-        }
-
-        ++count;
     }
-
-    file.close();
+    newData->buildFoldedOrder(chunkStarts.size() - 1);
+    auto const count = newData->size();
+    setData(std::move(newData));
 
     auto end = steady_clock::now();
     auto duration = duration_cast<milliseconds>(end - start).count();
-    std::cout << "CTagsLoader::load Loaded " << count << " tags from " << filename << " in "
-              << duration << " ms" << std::endl;
+    std::cout << "CTagsLoader::load Loaded " << count << " tags from " << fileName << " in "
+              << duration << " ms, using " << chunkStarts.size() - 1 << " threads" << std::endl;
 
     return true;
 }
 
 bool CTagsLoader::parseCtagsOutput(const std::string &ctagsOutput) {
+    // The output is kept in the tags file format, so it is indexed like a loaded file. It is
+    // added to a copy of the current tags.
+    auto newData = std::make_shared<TagData>();
+    auto &ownedText = newData->ownedText;
+    if (auto current = currentData()) {
+        ownedText.assign(current->text);
+        newData->tags = current->tags;
+    }
+    auto const firstNewLine = ownedText.size();
+
     std::stringstream ss(ctagsOutput);
     std::string line;
     while (std::getline(ss, line)) {
@@ -229,13 +317,164 @@ bool CTagsLoader::parseCtagsOutput(const std::string &ctagsOutput) {
 
         lineStream >> tagName >> type >> lineNumberStr >> tagFile >> std::ws;
         tagAddress = line.substr(lineStream.tellg());
+        std::replace(tagAddress.begin(), tagAddress.end(), '\t', ' ');
 
-        CTag newTag = {tagName, tagFile, tagAddress, TagFieldKey::Unknown, {}, {}};
-        tags.push_back(newTag);
+        ownedText += tagName + '\t' + tagFile + '\t' + tagAddress + '\n';
     }
+    if (ownedText.size() > std::numeric_limits<uint32_t>::max()) {
+        std::cerr << "CTagsLoader::parseCtagsOutput Error: Too many tags" << std::endl;
+        return false;
+    }
+    newData->text = ownedText;
+    newData->tags.indexLines(newData->text, firstNewLine, ownedText.size());
+    newData->buildFoldedOrder(1);
+    setData(std::move(newData));
     return true;
 }
 
+CTag CTagsLoader::TagData::tagAt(size_t index) const {
+    auto slice = [this](uint32_t from, uint32_t to) { return text.substr(from, to - from); };
+    return {
+        tagName(index),
+        slice(tags.fileStarts[index], tags.addressStarts[index] - 1),
+        slice(tags.addressStarts[index], tags.addressEnds[index]),
+        tags.fieldKeys[index],
+        slice(tags.valueStarts[index], tags.lineEnds[index]),
+    };
+}
+
+std::string_view CTagsLoader::TagData::tagName(size_t index) const {
+    auto const start = tags.lineStarts[index];
+    return text.substr(start, tags.fileStarts[index] - 1 - start);
+}
+
+// ctags sorts case sensitively by default, or case folded (--sort=foldcase), which needs no
+// sorting here. Each part is sorted on its own thread, then neighbouring parts are merged in
+// pairs, also in parallel, until one is left.
+void CTagsLoader::TagData::buildFoldedOrder(size_t parts) {
+    struct Key {
+        uint64_t prefix;
+        uint32_t index;
+    };
+    auto const count = size();
+    auto keys = std::vector<Key>(count);
+    auto isBefore = [this](const Key &a, const Key &b) {
+        if (a.prefix != b.prefix) {
+            return a.prefix < b.prefix;
+        }
+        auto const order = compareFolded(tagName(a.index), tagName(b.index));
+        return order != 0 ? order < 0 : a.index < b.index;
+    };
+
+    parts = std::clamp<size_t>(parts, 1, std::max<size_t>(count, 1));
+    auto bounds = std::vector<size_t>();
+    for (size_t i = 0; i <= parts; i++) {
+        bounds.push_back(count * i / parts);
+    }
+    runParallel(parts, [&](size_t part) {
+        auto const first = keys.begin() + bounds[part];
+        auto const last = keys.begin() + bounds[part + 1];
+        for (auto i = bounds[part]; i < bounds[part + 1]; i++) {
+            keys[i] = {foldedPrefix(tagName(i)), uint32_t(i)};
+        }
+        if (!std::is_sorted(first, last, isBefore)) {
+            std::sort(first, last, isBefore);
+        }
+    });
+    while (bounds.size() > 2) {
+        auto const pairs = (bounds.size() - 1) / 2;
+        runParallel(pairs, [&](size_t pair) {
+            std::inplace_merge(keys.begin() + bounds[pair * 2], keys.begin() + bounds[pair * 2 + 1],
+                               keys.begin() + bounds[pair * 2 + 2], isBefore);
+        });
+        auto merged = std::vector<size_t>();
+        for (size_t i = 0; i < bounds.size(); i += 2) {
+            merged.push_back(bounds[i]);
+        }
+        if (bounds.size() % 2 == 0) {
+            merged.push_back(bounds.back());
+        }
+        bounds = std::move(merged);
+    }
+
+    foldedOrder.resize(count);
+    for (size_t i = 0; i < count; i++) {
+        foldedOrder[i] = keys[i].index;
+    }
+}
+
+void CTagsLoader::TagColumns::reserve(size_t count) {
+    for (auto column : {&lineStarts, &fileStarts, &addressStarts, &addressEnds, &valueStarts,
+                        &lineEnds}) {
+        column->reserve(count);
+    }
+    fieldKeys.reserve(count);
+}
+
+void CTagsLoader::TagColumns::append(const TagColumns &other) {
+    auto appendColumn = [](auto &to, const auto &from) {
+        to.insert(to.end(), from.begin(), from.end());
+    };
+    appendColumn(lineStarts, other.lineStarts);
+    appendColumn(fileStarts, other.fileStarts);
+    appendColumn(addressStarts, other.addressStarts);
+    appendColumn(addressEnds, other.addressEnds);
+    appendColumn(valueStarts, other.valueStarts);
+    appendColumn(lineEnds, other.lineEnds);
+    appendColumn(fieldKeys, other.fieldKeys);
+}
+
+// Indexes the lines in text[from, to), which starts at a line
+void CTagsLoader::TagColumns::indexLines(std::string_view text, size_t from, size_t to) {
+    // A tag line is about 100 bytes, reserving avoids most of the reallocations
+    reserve(lineStarts.size() + (to - from) / 100);
+    while (from < to) {
+        auto newLine = text.find('\n', from);
+        auto lineEnd = newLine == std::string_view::npos || newLine > to ? to : newLine;
+        indexLine(text, uint32_t(from), uint32_t(lineEnd));
+        from = lineEnd + 1;
+    }
+}
+
+// Adds the tag in text[start, end), skipping malformed lines
+void CTagsLoader::TagColumns::indexLine(std::string_view text, uint32_t start, uint32_t end) {
+    if (end > start && text[end - 1] == '\r') {
+        end--;
+    }
+    auto line = text.substr(start, end - start);
+
+    auto tab1 = line.find('\t');
+    if (tab1 == std::string_view::npos) {
+        return;
+    }
+    auto tab2 = line.find('\t', tab1 + 1);
+    if (tab2 == std::string_view::npos) {
+        return;
+    }
+    auto tab3 = line.find('\t', tab2 + 1);
+
+    auto fieldKey = TagFieldKey::Unknown;
+    auto addressEnd = tab3 == std::string_view::npos ? line.size() : tab3;
+    auto valueStart = line.size();
+    if (tab3 != std::string_view::npos) {
+        auto tab4 = line.find('\t', tab3 + 1);
+        if (tab3 + 1 < line.size() && line[tab3 + 1] != '\t') {
+            fieldKey = mapCharToTagFieldKey(line[tab3 + 1]);
+            if (tab4 != std::string_view::npos && tab4 + 1 < line.size()) {
+                valueStart = tab4 + 1;
+            }
+        }
+    }
+
+    lineStarts.push_back(start);
+    fileStarts.push_back(start + uint32_t(tab1 + 1));
+    addressStarts.push_back(start + uint32_t(tab2 + 1));
+    addressEnds.push_back(start + uint32_t(addressEnd));
+    valueStarts.push_back(start + uint32_t(valueStart));
+    lineEnds.push_back(end);
+    fieldKeys.push_back(fieldKey);
+}
+
 std::string CTagsLoader::runCommand(const std::string &command) {
     std::string result;
     FILE *pipe = popen(command.c_str(), "r");
@@ -22,12 +22,18 @@
 // OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
 // SOFTWARE.
 
+#include <cstdint>
 #include <map>
+#include <memory>
+#include <mutex>
 #include <optional>
 #include <string>
+#include <string_view>
 #include <vector>
 
-enum class TagFieldKey {
+#include "MappedFile.hpp"
+
+enum class TagFieldKey : uint8_t {
     Unknown,
     // Classes and structures
     Class,
@@ -58,19 +64,31 @@ enum class TagFieldKey {
     Regex
 };
 
+// A view into the loaded tags, see CTagsLoader::TagList
 struct CTag {
     std::string_view name;
     std::string_view file;
     std::string_view address;
     TagFieldKey fieldKey;
     std::string_view fieldValue;
-
-    // Owns the memory
-    std::string originalLine;
 };
 
+// Each load builds a new set of tags, away from the loader, and then replaces the current one
+// under a lock. Lookups hold on to the set they searched, so loading and clearing can happen
+// on any thread, while lookups run.
 class CTagsLoader {
   public:
+    // The tags found by a lookup. The views stay valid as long as the list exists.
+    struct TagList {
+        std::shared_ptr<const void> owner;
+        std::vector<CTag> tags;
+
+        auto begin() const { return tags.begin(); }
+        auto end() const { return tags.end(); }
+        size_t size() const { return tags.size(); }
+        bool empty() const { return tags.empty(); }
+    };
+
     CTagsLoader(const std::string &ctagsBinary = "ctags");
     void setCTagsBinary(const std::string &newCtagsBinary);
 
@@ -81,17 +99,59 @@ class CTagsLoader {
     bool scanDirs(const std::string &dir);
     bool scanDirs(const std::string &ctagsFileName, const std::string &dir);
 
-    using TagListRef = std::vector<std::reference_wrapper<const CTag>>;
-    TagListRef findTags(const std::string &symbolName, bool exactMatch) const;
+    TagList findTags(const std::string &symbolName, bool exactMatch) const;
+    size_t size() const;
 
   private:
-    bool load();
+    // Smaller files are indexed on one thread
+    static constexpr size_t MinChunkSize = 4 * 1024 * 1024;
+
+    // One entry per tag, offsets into text. The name is [lineStart, fileStart - 1), the file
+    // [fileStart, addressStart - 1), the address [addressStart, addressEnd) and the field
+    // value [valueStart, lineEnd).
+    struct TagColumns {
+        std::vector<uint32_t> lineStarts;
+        std::vector<uint32_t> fileStarts;
+        std::vector<uint32_t> addressStarts;
+        std::vector<uint32_t> addressEnds;
+        std::vector<uint32_t> valueStarts;
+        std::vector<uint32_t> lineEnds;
+        std::vector<TagFieldKey> fieldKeys;
+
+        void reserve(size_t count);
+        void append(const TagColumns &other);
+        void indexLines(std::string_view text, size_t from, size_t to);
+        void indexLine(std::string_view text, uint32_t start, uint32_t end);
+    };
+
+    // A whole tags file, in one buffer: mapped, or owned (a copy, or ctags -x output).
+    // Not modified once it replaced the current tags.
+    struct TagData {
+        MappedFile mappedFile;
+        std::string ownedText;
+        std::string_view text;
+        TagColumns tags;
+        // Indexes into tags, sorted by the lower cased name, for prefix and case insensitive
+        // lookups
+        std::vector<uint32_t> foldedOrder;
+
+        size_t size() const { return tags.lineStarts.size(); }
+        std::string_view tagName(size_t index) const;
+        CTag tagAt(size_t index) const;
+        void buildFoldedOrder(size_t parts);
+    };
+
+    // A copy is made when the file is not kept, so nothing stays mapped
+    bool load(const std::string &fileName, bool copy = false);
     bool parseCtagsOutput(const std::string &ctagsOutput);
+    std::shared_ptr<const TagData> currentData() const;
+    void setData(std::shared_ptr<const TagData> newData);
     std::string runCommand(const std::string &command);
 
-    std::string filename;
-    std::vector<CTag> tags;
     std::string ctagsBinary;
+
+    mutable std::mutex mutex;
+    std::shared_ptr<const TagData> data;
 };
 
 std::string tagFieldKeyToString(TagFieldKey key);
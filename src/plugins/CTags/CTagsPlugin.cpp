@@ -444,8 +444,7 @@ CommandArgs CTagsPlugin::symbolInfoRequested(const QString &fileName, const QStr
 
     QVariantList tagList;
     auto tags = project->findTags(symbol.toStdString(), exactMatch);
-    for (auto &tagRef : tags) {
-        auto &tag = tagRef.get();
+    for (auto const &tag : tags) {
         tagList.append(QVariant::fromValue(CommandArgs{
             {GlobalArguments::FileName, QString::fromStdString(std::string{tag.file})},
             {GlobalArguments::Type, QString::fromStdString(tagFieldKeyToString(tag.fieldKey))},
@@ -13,7 +13,6 @@
 #include <QSettings>
 #include <QSocketNotifier>
 #include <QStandardPaths>
-#include <QStringListModel>
 #include <QTimer>
 #include <QWidgetAction>
 
@@ -30,7 +29,6 @@
 #define read _read
 #endif
 
-#include <CommandPaletteWidget/CommandPalette>
 #include <qmdiclient.h>
 #include <qmdihost.h>
 #include <qmdiserver.h>
@@ -48,6 +46,7 @@
 #include "plugins/filesystem/filesystemwidget.h"
 #include "ui_BuildRunOutput.h"
 #include "ui_ProjectManagerGUI.h"
+#include "widgets/QuickOpen.hpp"
 #include "widgets/qmdieditor.h"
 
 #define USE_TTY_FOR_TASKS
@@ -266,6 +265,25 @@ ProjectManagerPlugin::ProjectManagerPlugin() {
                                      .setDefaultValue(monospacedFont)
                                      .setValue(monospacedFont)
                                      .build());
+    config.configItems.push_back(
+        qmdiConfigItem::Builder()
+            .setDisplayName(tr("Index projects for faster search"))
+            .setDescription(tr("Keeps a search index of each project in its build directory. "
+                               "Uses memory and disk space, but searching large projects "
+                               "becomes much faster"))
+            .setKey(Config::SearchIndexKey)
+            .setType(qmdiConfigItem::Bool)
+            .setDefaultValue(false)
+            .build());
+    config.configItems.push_back(
+        qmdiConfigItem::Builder()
+            .setDisplayName(tr("Maximum search results"))
+            .setDescription(tr("Project search stops after this many matching lines (0 means "
+                               "no limit)"))
+            .setKey(Config::SearchMaxResultsKey)
+            .setType(qmdiConfigItem::UInt16)
+            .setDefaultValue(10000)
+            .build());
 
     /*
         config.configItems.push_back(qmdiConfigItem::Builder()
@@ -333,12 +351,30 @@ ProjectManagerPlugin::ProjectManagerPlugin() {
                                      .setDefaultValue(true)
                                      .setUserEditable(false)
                                      .build());
+    config.configItems.push_back(qmdiConfigItem::Builder()
+                                     .setKey(Config::SearchUseIgnoreFilesKey)
+                                     .setType(qmdiConfigItem::Bool)
+                                     .setDefaultValue(true)
+                                     .setUserEditable(false)
+                                     .build());
+    config.configItems.push_back(qmdiConfigItem::Builder()
+                                     .setKey(Config::SearchLiveKey)
+                                     .setType(qmdiConfigItem::Bool)
+                                     .setDefaultValue(false)
+                                     .setUserEditable(false)
+                                     .build());
     config.configItems.push_back(qmdiConfigItem::Builder()
                                      .setKey(Config::SearchRegexKey)
                                      .setType(qmdiConfigItem::Bool)
                                      .setDefaultValue(false)
                                      .setUserEditable(false)
                                      .build());
+    config.configItems.push_back(qmdiConfigItem::Builder()
+                                     .setKey(Config::SearchMultilineKey)
+                                     .setType(qmdiConfigItem::Bool)
+                                     .setDefaultValue(false)
+                                     .setUserEditable(false)
+                                     .build());
     config.configItems.push_back(qmdiConfigItem::Builder()
                                      .setKey(Config::SearchSensitiveKey)
                                      .setType(qmdiConfigItem::Bool)
@@ -720,27 +756,22 @@ void ProjectManagerPlugin::on_client_merged(qmdiHost *host) {
     quickOpen->setShortcut(QKeySequence(Qt::CTRL | Qt::Key_P));
     this->menus[tr("&Project")]->addAction(quickOpen);
 
-    commandPalette = new CommandPalette(manager);
-    commandPalette->setFilterModes(CommandPalette::FilterMode::FileMatch);
+    quickOpenPopup = new QuickOpen(manager);
     connect(quickOpen, &QAction::triggered, this, [this]() {
-        if (commandPalette->isVisible()) {
-            commandPalette->hide();
+        if (quickOpenPopup->isVisible()) {
+            quickOpenPopup->hide();
         } else {
-            auto model = new QStringListModel(commandPalette);
-            model->setStringList(gui->filesList->currentFilteredFiles());
-            commandPalette->setDataModel(model);
-            commandPalette->clearText();
-            commandPalette->show();
+            quickOpenPopup->setFiles(gui->filesList->getPaths(),
+                                     gui->filesList->currentFilteredFiles(),
+                                     frecency.scoresUnder(gui->filesList->getDir()));
+            quickOpenPopup->popup();
         }
     });
 
-    connect(commandPalette, &CommandPalette::didChooseItem, this,
-            [this](const QModelIndex index, const QAbstractItemModel *model) {
-                auto fname = model->data(index, Qt::DisplayRole).toString();
-                auto dirName = gui->filesList->getDir();
-                this->getManager()->openFile(dirName + fname);
-                commandPalette->setDataModel(nullptr);
-            });
+    connect(quickOpenPopup, &QuickOpen::fileChosen, this, [this](const QString &fname) {
+        auto dirName = gui->filesList->getDir();
+        this->getManager()->openFile(dirName + fname);
+    });
 }
 
 void ProjectManagerPlugin::configurationHasBeenModified() {
@@ -757,10 +788,13 @@ void ProjectManagerPlugin::configurationHasBeenModified() {
     auto newFont = QFont();
     newFont.fromString(getConfig().getConsoleFont());
     outputPanel->commandOuput->setFont(newFont);
+    searchPanelUI->setIndexingEnabled(getConfig().getSearchIndex());
+    searchPanelUI->setMaxResults(qMax(0, getConfig().getSearchMaxResults()));
 }
 
 void ProjectManagerPlugin::loadConfig(QSettings &settings) {
     IPlugin::loadConfig(settings);
+    frecency.load(FrecencyStore::defaultFileName());
 
     searchPanelUI->setSearchPath(getConfig().getSearchPath());
     searchPanelUI->setSearchPattern(getConfig().getSearchPattern());
@@ -769,7 +803,10 @@ void ProjectManagerPlugin::loadConfig(QSettings &settings) {
     searchPanelUI->setCollapseFiles(getConfig().getSearchCollapseFileNames());
     searchPanelUI->setSearchWholeWords(getConfig().getSearchWholeWords());
     searchPanelUI->setSearchRegex(getConfig().getSearchRegex());
+    searchPanelUI->setSearchMultiline(getConfig().getSearchMultiline());
     searchPanelUI->setSearchCaseSensitive(getConfig().getSearchSensitive());
+    searchPanelUI->setUseIgnoreFiles(getConfig().getSearchUseIgnoreFiles());
+    searchPanelUI->setLiveSearch(getConfig().getSearchLive());
 
     auto dirsToLoad = getConfig().getOpenDirs();
 
@@ -799,7 +836,11 @@ void ProjectManagerPlugin::saveConfig(QSettings &settings) {
     getConfig().setSearchCollapseFileNames(searchPanelUI->getCollapseFiles());
     getConfig().setSearchWholeWords(searchPanelUI->getSearchWholeWords());
     getConfig().setSearchRegex(searchPanelUI->getSearchRegex());
+    getConfig().setSearchMultiline(searchPanelUI->getSearchMultiline());
     getConfig().setSearchSensitive(searchPanelUI->getSearchCaseSensitive());
+    getConfig().setSearchUseIgnoreFiles(searchPanelUI->getUseIgnoreFiles());
+    getConfig().setSearchLive(searchPanelUI->getLiveSearch());
+    frecency.save(FrecencyStore::defaultFileName());
     IPlugin::saveConfig(settings);
 }
 
@@ -810,6 +851,9 @@ int ProjectManagerPlugin::canHandleCommand(const QString &command, const Command
     if (command == GlobalCommands::ClosedFile) {
         return true;
     }
+    if (command == GlobalCommands::ActivatedFile) {
+        return true;
+    }
     return false;
 }
 
@@ -859,7 +903,13 @@ auto verifyRunnable(const QString &fileName) -> bool {
 }
 
 CommandArgs ProjectManagerPlugin::handleCommand(const QString &command, const CommandArgs &args) {
+    if (command == GlobalCommands::ActivatedFile) {
+        frecency.record(args[GlobalArguments::FileName].toString(),
+                        FrecencyStore::Event::Activated);
+        return {};
+    }
     if (command == GlobalCommands::LoadedFile) {
+        frecency.record(args[GlobalArguments::FileName].toString(), FrecencyStore::Event::Opened);
         auto client = args.value(GlobalArguments::Client).value<qmdiClient *>();
         if (!client) {
             return {};
@@ -1,5 +1,6 @@
 #pragma once
 
+#include "FrecencyStore.hpp"
 #include "iplugin.h"
 #include "kitdefinitions.h"
 #include <QAbstractItemModel>
@@ -12,8 +13,8 @@ class DirectoryModel;
 class FilterOutProxyModel;
 class KitDefinitionModel;
 
-class CommandPalette;
 class ProjectSearch;
+class QuickOpen;
 
 struct ProjectBuildConfig;
 struct TaskInfo;
@@ -60,7 +61,12 @@ class ProjectManagerPlugin : public IPlugin {
         CONFIG_DEFINE(SearchWholeWords, bool);
         CONFIG_DEFINE(SearchSensitive, bool);
         CONFIG_DEFINE(SearchRegex, bool);
+        CONFIG_DEFINE(SearchMultiline, bool);
         CONFIG_DEFINE(SearchCollapseFileNames, bool);
+        CONFIG_DEFINE(SearchUseIgnoreFiles, bool);
+        CONFIG_DEFINE(SearchLive, bool);
+        CONFIG_DEFINE(SearchIndex, bool);
+        CONFIG_DEFINE(SearchMaxResults, int);
         qmdiPluginConfig *config;
     };
     Config &getConfig() {
@@ -130,7 +136,8 @@ class ProjectManagerPlugin : public IPlugin {
 
     KitDefinitionModel *kitsModel = nullptr;
     ProjectBuildModel *projectModel = nullptr;
-    CommandPalette *commandPalette = nullptr;
+    QuickOpen *quickOpenPopup = nullptr;
+    FrecencyStore frecency;
     ProjectSearch *searchPanelUI = nullptr;
 
     QAction *runAction = nullptr;
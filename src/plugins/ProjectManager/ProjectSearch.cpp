@@ -1,233 +1,90 @@
 #include <algorithm>
-#include <cstring>
-#include <fstream>
-#include <functional>
-#include <regex>
-#include <string>
-#include <vector>
-
-#include <QDirIterator>
+
+#include <QDir>
+#include <QFileInfo>
+#include <QFutureWatcher>
+#include <QHash>
+#include <QMessageBox>
 #include <QPushButton>
-#include <QThreadPool>
+#include <QTimer>
+#include <QtConcurrent/QtConcurrentMap>
 
 #include <pluginmanager.h>
 #include <qmdihost.h>
 
-#include "AnsiToHTML.hpp"
 #include "ProjectBuildConfig.h"
 #include "ProjectManagerPlg.h"
 #include "ProjectSearch.h"
+#include "SearchIndexer.h"
+#include "SearchReplacer.h"
+#include "SearchResultCache.h"
+#include "SearchResultsModel.h"
 #include "ui_ProjectSearchGUI.h"
+#include "widgets/qmdieditor.h"
 
-static auto regexEscape(const std::string &string) -> std::string {
-    static const std::string specialChars = "^$\\.*+?()[]{}|";
-    std::string result;
-    for (char c : string) {
-        if (specialChars.find(c) != std::string::npos) {
-            result += '\\';
-        }
-        result += c;
-    }
-    return result;
-}
-
-static auto FilenameMatches(const QString &fileName, const QString &goodList,
-                            const QString &badList) -> bool {
-    if (!badList.isEmpty()) {
-        auto list = badList.split(";");
-        for (auto const &rule : std::as_const(list)) {
-            if (rule.length() < 3) {
-                continue;
-            }
-            auto clean_rule = rule.trimmed();
-            if (clean_rule.isEmpty()) {
-                continue;
-            }
-            auto options = QRegularExpression::UnanchoredWildcardConversion;
-            auto pattern = QRegularExpression::wildcardToRegularExpression(rule, options);
-            auto regex = QRegularExpression(pattern);
-            auto matches = regex.match(fileName).hasMatch();
-            if (matches) {
-                return false;
-            }
-        }
-    }
-
-    auto filterMatchFound = true;
-    if (!goodList.isEmpty()) {
-        filterMatchFound = false;
-        auto list = goodList.split(";");
-        for (const auto &rule : std::as_const(list)) {
-            auto clean_rule = rule.trimmed();
-            if (clean_rule.isEmpty()) {
-                continue;
-            }
-            auto options = QRegularExpression::UnanchoredWildcardConversion;
-            auto pattern = QRegularExpression::wildcardToRegularExpression(rule, options);
-            auto regex = QRegularExpression(pattern);
-            auto matches = regex.match(fileName).hasMatch();
-            if (matches) {
-                filterMatchFound = true;
-                break;
-            }
-        }
-    }
-    return filterMatchFound;
-}
+// Typing pauses shorter than this do not start a live search
+static constexpr auto LiveSearchDelay = 200;
+// Files listed when some files could not be replaced
+static constexpr auto MaxReportedReplaceErrors = 20;
 
-struct SearchOptions {
-    bool caseSensitive;
-    bool wholeWord;
-    bool useRegex;
-    bool searchInBinaries;
+struct ReplaceJob {
+    QString fileName;
+    QList<FoundData> lines;
 };
 
-auto static searchTextFile(std::ifstream &file, const std::string &searchString,
-                           SearchOptions options,
-                           std::function<void(const std::string &, size_t)> callback) -> void {
-    auto line = std::string();
-    auto lineNumber = size_t(0);
-
-    std::regex regex;
-    bool useRegexSearch = options.useRegex || options.wholeWord || !options.caseSensitive;
-
-    if (useRegexSearch) {
-        auto flags = std::regex_constants::ECMAScript;
-        if (!options.caseSensitive) {
-            flags |= std::regex_constants::icase;
-        }
-
-        auto pattern = std::string();
-        if (options.useRegex) {
-            pattern = searchString;
-        } else {
-            pattern = regexEscape(searchString);
-            if (options.wholeWord) {
-                pattern = "\\b" + pattern + "\\b";
-            }
-        }
-
-        try {
-            regex.assign(pattern, flags);
-        } catch (...) {
-            return;
-        }
-    }
-
-    while (std::getline(file, line)) {
-        bool match = false;
-        if (useRegexSearch) {
-            match = std::regex_search(line, regex);
-        } else {
-            match = (line.find(searchString) != std::string::npos);
-        }
-
-        if (match) {
-            callback(line, lineNumber);
-        }
-        lineNumber++;
-    }
-}
-
-auto static searchBinaryFile(std::ifstream &file, const std::string &searchString,
-
-                             std::function<void(const std::string &, size_t)> callback) -> void {
-    if (!file.is_open() || searchString.empty()) {
-        return;
-    }
-
-    auto constexpr bufferSize = 4096;
-    auto const searchLen = searchString.size();
-    auto const overlap = searchLen > 1 ? searchLen - 1 : 0;
-
-    auto buffer = std::vector<char>(bufferSize + overlap);
-    auto fileOffset = size_t{0};
-    auto prevTailSize = size_t{0};
-
-    while (file) {
-        file.read(buffer.data() + prevTailSize, bufferSize);
-        auto bytesRead = file.gcount();
-
-        if (bytesRead == 0) {
-            break;
-        }
-
-        auto totalBytes = prevTailSize + bytesRead;
-        for (auto i = 0; i + searchLen <= totalBytes; ++i) {
-            if (std::memcmp(buffer.data() + i, searchString.data(), searchLen) == 0) {
-                auto afterMatch = std::min<size_t>(100, totalBytes - (i + searchLen));
-                auto result = std::string(buffer.data() + i + searchLen, afterMatch);
-
-                if (afterMatch < 100) {
-                    auto extra = std::vector<char>(100 - afterMatch);
-                    auto oldPos = file.tellg();
-                    file.seekg(fileOffset + i + searchLen + afterMatch, std::ios::beg);
-                    file.read(extra.data(), extra.size());
-
-                    auto extraRead = file.gcount();
-                    result.append(extra.data(), extraRead);
-                    file.seekg(oldPos);
-                }
-                callback(result, fileOffset + i);
-            }
-        }
-
-        if (overlap > 0) {
-            std::memmove(buffer.data(), buffer.data() + totalBytes - overlap, overlap);
-        }
-        fileOffset += bytesRead;
-        prevTailSize = overlap;
-    }
-}
-
-auto static searchFile(const std::string &filename, const std::string &searchString,
-                       SearchOptions options,
-                       std::function<void(const std::string &, size_t)> callback) -> void {
-    std::ifstream file(filename);
-    if (!file.is_open()) {
-        return;
+// A longer plain text query can only match lines the previous one matched, so its results
+// can be filtered out of the previous ones, instead of searching the disk again. Whole words
+// and regular expressions do not have this property, and binary matches keep only a part of
+// the line, so those are always searched again.
+static auto canNarrow(const SearchRequest &previous, const SearchRequest &next) -> bool {
+    auto const &p = previous.options;
+    auto const &n = next.options;
+    if (p.useRegex || p.wholeWord || p.searchInBinaries || p.useRegex != n.useRegex ||
+        p.wholeWord != n.wholeWord || p.searchInBinaries != n.searchInBinaries ||
+        p.caseSensitive != n.caseSensitive) {
+        return false;
     }
-
-    auto firstLines = std::string();
-    auto line = std::string();
-    for (auto i = 0; i < 5; i++) {
-        std::getline(file, line);
-        firstLines += line;
+    if (previous.startPath != next.startPath || previous.includeList != next.includeList ||
+        previous.excludeList != next.excludeList ||
+        previous.useIgnoreFiles != next.useIgnoreFiles || previous.searchText.empty()) {
+        return false;
     }
-
-    file.seekg(0);
-    if (isPlainText(QString::fromStdString(firstLines))) {
-        searchTextFile(file, searchString, options, callback);
-    } else {
-        if (options.searchInBinaries) {
-            searchBinaryFile(file, searchString, callback);
-        }
+    if (p.caseSensitive) {
+        return next.searchText.find(previous.searchText) != std::string::npos;
     }
+    return QString::fromStdString(next.searchText)
+        .contains(QString::fromStdString(previous.searchText), Qt::CaseInsensitive);
 }
 
 ProjectSearch::ProjectSearch(QWidget *parent, ProjectBuildModel *m)
     : QWidget(parent), ui(new Ui::ProjectSearchGUI) {
     ui->setupUi(this);
     this->model = m;
-
-    QStringList headerLabels;
-    headerLabels << tr("Text") << tr("Line");
-    ui->treeWidget->setHeaderLabels(headerLabels);
-    ui->treeWidget->header()->setSectionResizeMode(0, QHeaderView::Stretch);
-    ui->treeWidget->header()->setSectionResizeMode(1, QHeaderView::ResizeToContents);
+    this->engine = new SearchEngine;
+    this->indexer = new SearchIndexer(m, this);
+    this->results = new SearchResultsModel(this);
+    this->resultCache = std::make_shared<SearchResultCache>();
+    this->liveTimer = new QTimer(this);
+    this->searchButtonText = ui->searchButton->text();
+    liveTimer->setSingleShot(true);
+    liveTimer->setInterval(LiveSearchDelay);
+    connect(liveTimer, &QTimer::timeout, this, &ProjectSearch::liveSearch);
+
+    ui->resultsView->setModel(results);
+    ui->resultsView->header()->setSectionResizeMode(0, QHeaderView::Stretch);
+    ui->resultsView->header()->setSectionResizeMode(1, QHeaderView::ResizeToContents);
 
     ui->pathEdit->setFileMode(false);
     ui->pathEdit->setPlaceholderText(tr("Search in directory"));
     ui->pathEdit->setPath(QDir::homePath());
 
-    auto host = dynamic_cast<PluginManager *>(parent);
-    connect(ui->treeWidget, &QTreeWidget::itemClicked, this, [host](QTreeWidgetItem *item, int) {
-        auto parent = item->parent();
-        if (!parent) {
+    this->host = dynamic_cast<PluginManager *>(parent);
+    connect(ui->resultsView, &QTreeView::clicked, this, [host = host](const QModelIndex &index) {
+        if (!index.parent().isValid()) {
             return;
         }
-        auto fileName = parent->text(2);
-        auto line = item->text(1).toInt() - 1;
+        auto fileName = index.data(SearchResultsModel::FullFileNameRole).toString();
+        auto line = index.data(SearchResultsModel::LineNumberRole).toInt();
         host->openFile(fileName, line);
         auto w = dynamic_cast<QWidget *>(host->currentClient());
         if (w) {
@@ -255,6 +112,8 @@ ProjectSearch::ProjectSearch(QWidget *parent, ProjectBuildModel *m)
     });
 
     connect(ui->searchButton, &QPushButton::clicked, this, &ProjectSearch::searchButton_clicked);
+    connect(ui->replaceButton, &QPushButton::clicked, this, &ProjectSearch::replaceButton_clicked);
+    connect(ui->replaceWith, &QLineEdit::textChanged, this, &ProjectSearch::updateReplacePreview);
 
     connect(ui->pathEdit, &PathWidget::pathChanged, this, [this](const QString &newPath) {
         auto i = this->model->findConfigDirIndex(newPath);
@@ -270,14 +129,18 @@ ProjectSearch::ProjectSearch(QWidget *parent, ProjectBuildModel *m)
         if (!toggled) {
             return;
         }
-        auto count = ui->treeWidget->topLevelItemCount(); //
-        for (auto i = 0; i < count; ++i) {
-            auto item = ui->treeWidget->topLevelItem(i); //
-            if (item) {
-                ui->treeWidget->collapseItem(item);
-            }
+        ui->resultsView->collapseAll();
+    });
+
+    connect(results, &SearchResultsModel::filesAdded, this, [this](int first, int last) {
+        if (ui->collapseFileNames->isChecked()) {
+            return;
+        }
+        for (auto row = first; row <= last; row++) {
+            ui->resultsView->expand(results->index(row, 0));
         }
     });
+    connect(results, &SearchResultsModel::matchLimitReached, this, [this]() { engine->stop(); });
 
     auto updateTooltips = [this]() {
         ui->caseSensitiveBtn->setToolTip(ui->caseSensitiveBtn->isChecked()
@@ -287,15 +150,23 @@ ProjectSearch::ProjectSearch(QWidget *parent, ProjectBuildModel *m)
                                                                    : tr("Whole Word (Off)"));
         ui->regexBtn->setToolTip(ui->regexBtn->isChecked() ? tr("Regular Expression (On)")
                                                            : tr("Regular Expression (Off)"));
+        ui->multilineBtn->setToolTip(ui->multilineBtn->isChecked()
+                                         ? tr("Multiline, matches may span lines (On)")
+                                         : tr("Multiline, matches may span lines (Off)"));
         ui->searchInBinaryFiles->setToolTip(ui->searchInBinaryFiles->isChecked()
                                                 ? tr("Search in binary files as well")
                                                 : tr("Search in text files only"));
+        ui->useIgnoreFiles->setToolTip(ui->useIgnoreFiles->isChecked()
+                                           ? tr("Skip files listed in .gitignore/.ignore")
+                                           : tr("Search files listed in .gitignore/.ignore"));
     };
 
     connect(ui->caseSensitiveBtn, &QToolButton::toggled, this, updateTooltips);
     connect(ui->wholeWordBtn, &QToolButton::toggled, this, updateTooltips);
     connect(ui->regexBtn, &QToolButton::toggled, this, updateTooltips);
+    connect(ui->multilineBtn, &QToolButton::toggled, this, updateTooltips);
     connect(ui->searchInBinaryFiles, &QCheckBox::toggled, this, updateTooltips);
+    connect(ui->useIgnoreFiles, &QCheckBox::toggled, this, updateTooltips);
     updateTooltips();
 
     auto validateRegex = [this]() {
@@ -305,22 +176,54 @@ ProjectSearch::ProjectSearch(QWidget *parent, ProjectBuildModel *m)
             return;
         }
 
-        try {
-            std::regex(ui->searchFor->text().toStdString());
+        auto options = SearchOptions();
+        options.useRegex = true;
+        options.caseSensitive = ui->caseSensitiveBtn->isChecked();
+        auto matcher = SearchMatcher(ui->searchFor->text().toStdString(), options);
+        if (matcher.isValid()) {
             ui->searchFor->setStyleSheet("");
             ui->searchFor->setToolTip("");
-        } catch (const std::regex_error &e) {
+        } else {
             ui->searchFor->setStyleSheet("background-color: #550000; color: white;");
-            ui->searchFor->setToolTip(e.what());
+            ui->searchFor->setToolTip(matcher.errorString());
         }
     };
 
     connect(ui->searchFor, &QLineEdit::textChanged, this, validateRegex);
     connect(ui->regexBtn, &QToolButton::toggled, this, validateRegex);
     validateRegex();
+
+    // Multiline only applies to regular expressions. Replacing works line by line, so it is
+    // not available for multiline matches.
+    auto updateMultiline = [this]() {
+        auto multiline = ui->regexBtn->isChecked() && ui->multilineBtn->isChecked();
+        ui->multilineBtn->setEnabled(ui->regexBtn->isChecked());
+        ui->replaceWith->setEnabled(!multiline);
+        ui->replaceButton->setEnabled(!multiline);
+    };
+    connect(ui->regexBtn, &QToolButton::toggled, this, updateMultiline);
+    connect(ui->multilineBtn, &QToolButton::toggled, this, updateMultiline);
+    updateMultiline();
+
+    auto scheduleLiveSearch = [this]() {
+        if (ui->liveSearchBtn->isChecked()) {
+            liveTimer->start();
+        }
+    };
+    connect(ui->searchFor, &QLineEdit::textChanged, this, scheduleLiveSearch);
+    connect(ui->caseSensitiveBtn, &QToolButton::toggled, this, scheduleLiveSearch);
+    connect(ui->wholeWordBtn, &QToolButton::toggled, this, scheduleLiveSearch);
+    connect(ui->regexBtn, &QToolButton::toggled, this, scheduleLiveSearch);
+    connect(ui->multilineBtn, &QToolButton::toggled, this, scheduleLiveSearch);
+    connect(ui->liveSearchBtn, &QToolButton::toggled, this, scheduleLiveSearch);
+    connect(ui->searchInBinaryFiles, &QCheckBox::toggled, this, scheduleLiveSearch);
+    connect(ui->useIgnoreFiles, &QCheckBox::toggled, this, scheduleLiveSearch);
 }
 
-ProjectSearch::~ProjectSearch() { delete ui; }
+ProjectSearch::~ProjectSearch() {
+    delete engine;
+    delete ui;
+}
 
 void ProjectSearch::setFocusOnSearch() {
     ui->searchFor->setFocus();
@@ -371,6 +274,26 @@ auto ProjectSearch::getSearchRegex() const -> bool { return ui->regexBtn->isChec
 
 auto ProjectSearch::setSearchRegex(bool status) -> void { ui->regexBtn->setChecked(status); }
 
+auto ProjectSearch::getSearchMultiline() const -> bool { return ui->multilineBtn->isChecked(); }
+
+auto ProjectSearch::setSearchMultiline(bool status) -> void {
+    ui->multilineBtn->setChecked(status);
+}
+
+auto ProjectSearch::getUseIgnoreFiles() const -> bool { return ui->useIgnoreFiles->isChecked(); }
+
+auto ProjectSearch::setUseIgnoreFiles(bool status) -> void {
+    ui->useIgnoreFiles->setChecked(status);
+}
+
+auto ProjectSearch::getLiveSearch() const -> bool { return ui->liveSearchBtn->isChecked(); }
+
+auto ProjectSearch::setLiveSearch(bool status) -> void { ui->liveSearchBtn->setChecked(status); }
+
+auto ProjectSearch::setIndexingEnabled(bool enabled) -> void { indexer->setEnabled(enabled); }
+
+auto ProjectSearch::setMaxResults(size_t max) -> void { results->setMaxMatches(max); }
+
 void ProjectSearch::updateProjectList() {
     ui->sourceCombo->clear();
     ui->sourceCombo->addItem(tr("Custom"));
@@ -378,113 +301,238 @@ void ProjectSearch::updateProjectList() {
         auto p = model->getConfig(i);
         ui->sourceCombo->addItem(p->name);
     }
+    indexer->updateProjects();
     emit ui->pathEdit->pathChanged(ui->pathEdit->path());
 }
 
 void ProjectSearch::searchButton_clicked() {
-    static bool running = false;
-
-    if (running) {
-        running = false;
+    if (engine->isRunning()) {
+        engine->stop();
         return;
     }
+    liveTimer->stop();
+    startSearch(buildRequest(), true);
+}
 
-    this->ui->treeWidget->clear();
+auto ProjectSearch::buildRequest() -> SearchRequest {
+    auto request = SearchRequest();
+    request.includeList = ui->includeFiles->text();
+    request.excludeList = ui->excludeFiles->text();
+    request.searchText = ui->searchFor->text().toStdString();
+    request.startPath = QDir::toNativeSeparators(ui->pathEdit->path());
+    request.options.caseSensitive = ui->caseSensitiveBtn->isChecked();
+    request.options.wholeWord = ui->wholeWordBtn->isChecked();
+    request.options.useRegex = ui->regexBtn->isChecked();
+    request.options.multiline = ui->multilineBtn->isChecked();
+    request.options.searchInBinaries = ui->searchInBinaryFiles->isChecked();
+    request.useIgnoreFiles = ui->useIgnoreFiles->isChecked();
+    return request;
+}
 
-    auto allowList = ui->includeFiles->text();
-    auto denyList = ui->excludeFiles->text();
-    auto originalText = ui->searchButton->text();
+auto ProjectSearch::startSearch(const SearchRequest &request, bool useCache) -> void {
+    // Starting a search cancels the previous one, whose results are ignored from now on
+    auto searchId = results->beginSearch();
+    lastRequest = request;
+    lastRequest.index = indexer->indexForSearch(request.startPath);
+    lastRequest.cache = useCache ? resultCache : nullptr;
+    lastRequest.snapshots = takeSnapshots();
+    lastSearchComplete = false;
+    setSearching(true);
+
+    auto onFile = [this, searchId](SearchFileResult &&result) {
+        results->queueResult(searchId, std::move(result));
+    };
 
-    auto searchText = ui->searchFor->text().toStdString();
-    auto startSearchPath = QDir::toNativeSeparators(ui->pathEdit->path());
-    SearchOptions options;
-    options.caseSensitive = ui->caseSensitiveBtn->isChecked();
-    options.wholeWord = ui->wholeWordBtn->isChecked();
-    options.useRegex = ui->regexBtn->isChecked();
-    options.searchInBinaries = ui->searchInBinaryFiles->isChecked();
+    // this is done, since the progress indicator needs to be stopped from the main thread
+    auto onFinished = [this, searchId](bool stopped) {
+        QMetaObject::invokeMethod(
+            this,
+            [this, searchId, stopped]() {
+                if (searchId != results->currentSearch()) {
+                    return;
+                }
+                results->endSearch(searchId);
+                lastSearchComplete = !stopped && !results->isTruncated();
+                setSearching(false);
+            },
+            Qt::QueuedConnection);
+    };
+    engine->start(lastRequest, onFile, onFinished);
+    updateReplacePreview();
+}
 
-    ui->searchButton->setText("(click to &stop)");
-    ui->progressIndicator->start();
-    running = true;
+auto ProjectSearch::liveSearch() -> void {
+    auto request = buildRequest();
+    if (request.searchText.empty()) {
+        engine->stop();
+        results->endSearch(results->beginSearch());
+        lastSearchComplete = false;
+        setSearching(false);
+        return;
+    }
 
-    if (allowList.isEmpty()) {
-        allowList = "*";
+    if (lastSearchComplete && canNarrow(lastRequest, request)) {
+        auto matcher = SearchMatcher(request.searchText, request.options);
+        results->narrowSearch(
+            [&matcher](const FoundData &found) { return matcher.matchesLine(found.line); });
+        lastRequest.searchText = request.searchText;
+        updateReplacePreview();
+        return;
     }
-    QThreadPool::globalInstance()->start([this, originalText, allowList, denyList, searchText,
-                                          startSearchPath, options]() {
-        QDirIterator it(startSearchPath, allowList.split(";"), QDir::Files,
-                        QDirIterator::Subdirectories);
-        while (it.hasNext()) {
-            auto fullFileName = QDir::toNativeSeparators(it.next());
-            auto *foundData = new QList<FoundData>;
-            if (!fullFileName.startsWith(startSearchPath)) {
-                continue;
-            }
+    // Queries typed on the way to the one wanted are not worth caching
+    startSearch(request, false);
+}
 
-            auto trimCount = startSearchPath.size();
-            if (startSearchPath.endsWith('\\') || startSearchPath.endsWith('/')) {
-                trimCount++;
-            }
-            auto shortFileName = fullFileName.mid(trimCount);
-            if (shortFileName.startsWith('/') || shortFileName.startsWith('\\')) {
-                shortFileName.remove(0, 1);
-            }
+auto ProjectSearch::setSearching(bool searching) -> void {
+    if (searching) {
+        ui->searchButton->setText(tr("(click to &stop)"));
+        ui->progressIndicator->start();
+    } else {
+        ui->searchButton->setText(searchButtonText);
+        ui->progressIndicator->stop();
+    }
+}
 
-            if (!FilenameMatches(fullFileName, allowList, denyList)) {
-                continue;
-            };
-            searchFile(fullFileName.toStdString(), searchText, options,
-                       [foundData](auto line, auto line_number) {
-                           foundData->push_back({line, line_number});
-                       });
-
-            if (!foundData->empty()) {
-                // clang-format off
-                QMetaObject::invokeMethod(
-                    this, "file_searched", Qt::QueuedConnection,
-                    Q_ARG(QString, fullFileName),
-                    Q_ARG(QString, shortFileName),
-                    Q_ARG(QList<FoundData>*, foundData)
-                );
-                // clang-format on
-            } else {
-                delete foundData;
-            }
+auto ProjectSearch::makeReplacer() const -> std::shared_ptr<const SearchReplacer> {
+    auto const &options = lastRequest.options;
+    if (lastRequest.searchText.empty() || (options.useRegex && options.multiline)) {
+        return {};
+    }
+    auto replacer = std::make_shared<const SearchReplacer>(
+        lastRequest.searchText, lastRequest.options, ui->replaceWith->text());
+    if (!replacer->isValid()) {
+        return {};
+    }
+    return replacer;
+}
 
-            if (!running) {
-                break;
-            }
+auto ProjectSearch::updateReplacePreview() -> void {
+    if (ui->replaceWith->text().isEmpty()) {
+        results->setReplacePreview({});
+        return;
+    }
+    results->setReplacePreview(makeReplacer());
+}
+
+// By absolute file name, new documents without a name are skipped
+auto ProjectSearch::openEditors() const -> QHash<QString, qmdiEditor *> {
+    auto editors = QHash<QString, qmdiEditor *>();
+    for (auto i = size_t(0); host && i < host->visibleTabs(); i++) {
+        auto editor = dynamic_cast<qmdiEditor *>(host->getMdiClient(i));
+        if (editor && !editor->mdiClientFileName().isEmpty()) {
+            editors.insert(QFileInfo(editor->mdiClientFileName()).absoluteFilePath(), editor);
         }
+    }
+    return editors;
+}
 
-        // this is done, since the progress indicator needs to be stopped from the main thread
-        QTimer::singleShot(0, this, [this, originalText]() {
-            ui->searchButton->setText(originalText);
-            ui->progressIndicator->stop();
-            running = false;
-        });
-    });
+// Copies the text of the modified documents, so the search sees unsaved changes. The others
+// match the files on disk, which are read as usual (as are tabs which were restored but not
+// loaded yet). This runs on every search, so nothing else is copied.
+auto ProjectSearch::takeSnapshots() const -> std::shared_ptr<const QHash<QString, QString>> {
+    auto snapshots = std::make_shared<QHash<QString, QString>>();
+    auto editors = openEditors();
+    for (auto it = editors.cbegin(); it != editors.cend(); ++it) {
+        if (it.value()->isDocumentLoaded() && it.value()->isModified()) {
+            snapshots->insert(QDir::toNativeSeparators(it.key()), it.value()->getDocumentText());
+        }
+    }
+    if (snapshots->isEmpty()) {
+        return {};
+    }
+    return snapshots;
 }
 
-void ProjectSearch::file_searched(QString fullFileName, QString shortFileName,
-                                  QList<FoundData> *foundData) {
-    auto dirItem = new QTreeWidgetItem(ui->treeWidget);
-    dirItem->setText(0, shortFileName);
-    dirItem->setText(2, fullFileName);
-    dirItem->setToolTip(0, fullFileName);
-
-    for (const auto &s : *foundData) {
-        auto lineItem = new QTreeWidgetItem(dirItem);
-        auto trimmedText =
-            QString::fromUtf8(s.line.data(), std::min(s.line.size(), size_t{256})).trimmed();
-
-        lineItem->setText(0, trimmedText);
-        lineItem->setText(1, QString::number(s.lineNumber + 1));
-        lineItem->setToolTip(0, trimmedText);
-        lineItem->setToolTip(1, shortFileName);
+void ProjectSearch::replaceButton_clicked() {
+    auto replacer = makeReplacer();
+    if (engine->isRunning() || results->getFiles().empty() || !replacer) {
+        return;
     }
-    delete foundData;
-    if (!ui->collapseFileNames->isChecked()) {
-        ui->treeWidget->expandItem(dirItem);
+    auto answer = QMessageBox::question(this, tr("Replace"),
+                                        tr("Replace %1 matches in %2 files with \"%3\"?")
+                                            .arg(results->getMatchCount())
+                                            .arg(results->getFiles().size())
+                                            .arg(ui->replaceWith->text()));
+    if (answer != QMessageBox::Yes) {
+        return;
     }
-    ui->treeWidget->header()->setSectionResizeMode(0, QHeaderView::Stretch);
+
+    // Files open in an editor are changed through their document (and can be undone there),
+    // the rest are rewritten on disk, in parallel
+    auto editors = openEditors();
+
+    auto jobs = QList<ReplaceJob>();
+    auto editorMatches = size_t(0);
+    auto editorFiles = size_t(0);
+    auto editorErrors = QStringList();
+    for (auto const &file : results->getFiles()) {
+        // Matches in binary files are byte offsets, not lines
+        if (file.found.isEmpty() || file.found.front().binary) {
+            continue;
+        }
+        auto editor = editors.value(QFileInfo(file.fullFileName).absoluteFilePath());
+        if (!editor || !editor->isDocumentLoaded()) {
+            jobs.append({file.fullFileName, file.found});
+            continue;
+        }
+        auto lines = QMap<size_t, QString>();
+        for (auto const &found : file.found) {
+            auto line = QString::fromStdString(found.line);
+            if (line.endsWith('\r')) {
+                line.chop(1);
+            }
+            lines.insert(found.lineNumber, line);
+        }
+        auto replaced = editor->replaceInLines(
+            lines, [&replacer](QString &line) { return replacer->replaceLine(line); });
+        if (!replaced) {
+            editorErrors.append(QString("%1: %2").arg(
+                file.fullFileName, tr("The file was modified since it was searched")));
+            continue;
+        }
+        editorMatches += *replaced;
+        editorFiles += *replaced != 0 ? 1 : 0;
+    }
+
+    ui->replaceButton->setEnabled(false);
+    ui->progressIndicator->start();
+    auto watcher = new QFutureWatcher<ReplaceFileResult>(this);
+    connect(watcher, &QFutureWatcherBase::finished, this,
+            [this, watcher, editorMatches, editorFiles, editorErrors]() {
+                auto matches = editorMatches;
+                auto files = editorFiles;
+                auto errors = editorErrors;
+                for (auto const &result : watcher->future().results()) {
+                    if (!result.error.isEmpty()) {
+                        errors.append(QString("%1: %2").arg(result.fileName, result.error));
+                    } else if (result.replaced != 0) {
+                        matches += result.replaced;
+                        files++;
+                    }
+                }
+                watcher->deleteLater();
+                ui->replaceButton->setEnabled(
+                    !(ui->regexBtn->isChecked() && ui->multilineBtn->isChecked()));
+                ui->progressIndicator->stop();
+
+                if (!errors.isEmpty()) {
+                    auto count = errors.size();
+                    if (count > MaxReportedReplaceErrors) {
+                        errors.resize(MaxReportedReplaceErrors);
+                        errors.append(tr("(and %1 more)").arg(count - MaxReportedReplaceErrors));
+                    }
+                    QMessageBox::warning(this, tr("Replace"),
+                                         tr("Replaced %1 matches in %2 files.\n"
+                                            "These files were not changed:\n%3")
+                                             .arg(matches)
+                                             .arg(files)
+                                             .arg(errors.join('\n')));
+                }
+
+                // Show what is left
+                startSearch(lastRequest, lastRequest.cache != nullptr);
+            });
+    watcher->setFuture(QtConcurrent::mapped(std::move(jobs), [replacer](const ReplaceJob &job) {
+        return replacer->replaceInFile(job.fileName, job.lines);
+    }));
 }
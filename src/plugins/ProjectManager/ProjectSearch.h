@@ -1,18 +1,22 @@
 #pragma once
 
+#include <memory>
+
 #include <QWidget>
 
+#include "SearchEngine.h"
+
 namespace Ui {
 class ProjectSearchGUI;
 }
 
+class QTimer;
+class PluginManager;
+class qmdiEditor;
 class ProjectBuildModel;
-class QTreeWidgetItem;
-
-struct FoundData {
-    std::string line;
-    size_t lineNumber = 0;
-};
+class SearchIndexer;
+class SearchReplacer;
+class SearchResultsModel;
 
 class ProjectSearch : public QWidget {
     Q_OBJECT
@@ -38,13 +42,41 @@ class ProjectSearch : public QWidget {
     auto setSearchWholeWords(bool status) -> void;
     auto getSearchRegex() const -> bool;
     auto setSearchRegex(bool status) -> void;
+    auto getSearchMultiline() const -> bool;
+    auto setSearchMultiline(bool status) -> void;
+    auto getUseIgnoreFiles() const -> bool;
+    auto setUseIgnoreFiles(bool status) -> void;
+    auto getLiveSearch() const -> bool;
+    auto setLiveSearch(bool status) -> void;
+    auto setIndexingEnabled(bool enabled) -> void;
+    auto setMaxResults(size_t max) -> void;
 
   public slots:
     auto updateProjectList() -> void;
     auto searchButton_clicked() -> void;
-    void file_searched(QString fullFileName, QString shortFileName, QList<FoundData> *foundData);
+    auto replaceButton_clicked() -> void;
 
   private:
+    auto buildRequest() -> SearchRequest;
+    auto startSearch(const SearchRequest &request, bool useCache) -> void;
+    auto liveSearch() -> void;
+    auto setSearching(bool searching) -> void;
+    auto makeReplacer() const -> std::shared_ptr<const SearchReplacer>;
+    auto updateReplacePreview() -> void;
+    auto openEditors() const -> QHash<QString, qmdiEditor *>;
+    auto takeSnapshots() const -> std::shared_ptr<const QHash<QString, QString>>;
+
     Ui::ProjectSearchGUI *ui;
+    PluginManager *host;
     ProjectBuildModel *model;
+    SearchEngine *engine;
+    SearchIndexer *indexer;
+    SearchResultsModel *results;
+    std::shared_ptr<SearchResultCache> resultCache;
+    QTimer *liveTimer;
+    QString searchButtonText;
+
+    // The last search started, and whether it found all there was to find
+    SearchRequest lastRequest;
+    bool lastSearchComplete = false;
 };
@@ -0,0 +1,124 @@
+/**
+ * \file SearchCommandLine.cpp
+ * \brief Implementation of the headless project search, run from the command line
+ * \author Diego Iastrubni (diegoiast@gmail.com)
+ *  License MIT
+ */
+
+#include <cstdio>
+#include <cstring>
+#include <memory>
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QDir>
+#include <QElapsedTimer>
+
+#include "SearchCommandLine.h"
+#include "SearchEngine.h"
+#include "SearchMatcher.h"
+#include "TrigramIndex.h"
+
+auto isSearchCommandLine(int argc, char *argv[]) -> bool {
+    for (auto i = 1; i < argc; i++) {
+        if (std::strcmp(argv[i], "--grep") == 0 || std::strncmp(argv[i], "--grep=", 7) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+auto runSearchCommandLine(int argc, char *argv[]) -> int {
+    QCoreApplication app(argc, argv);
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription(app.tr("Search a directory, like the search panel does"));
+    parser.addHelpOption();
+    parser.addOptions({
+        {"grep", app.tr("Search for <pattern>."), app.tr("pattern")},
+        {{"s", "case-sensitive"}, app.tr("Match case.")},
+        {{"w", "word"}, app.tr("Match whole words only.")},
+        {{"e", "regex"}, app.tr("The pattern is a regular expression.")},
+        {{"U", "multiline"}, app.tr("Regular expressions may match across lines.")},
+        {{"a", "binary"}, app.tr("Search binary files as well.")},
+        {"include", app.tr("Search only files matching <globs>."), app.tr("globs")},
+        {"exclude", app.tr("Skip files matching <globs>."), app.tr("globs")},
+        {"no-ignore", app.tr("Do not skip files listed in .gitignore/.ignore.")},
+        {"index", app.tr("Build a trigram index of the directory first, and use it.")},
+        {{"j", "threads"}, app.tr("Use <count> threads (default: all cores)."), app.tr("count")},
+        {{"q", "quiet"}, app.tr("Print only the summary.")},
+    });
+    parser.addPositionalArgument(app.tr("dir"), app.tr("Directory to search (default: .)"),
+                                 "[dir]");
+    parser.process(app);
+
+    auto request = SearchRequest();
+    request.searchText = parser.value("grep").toStdString();
+    auto dir = QDir(parser.positionalArguments().value(0, "."));
+    request.startPath = QDir::toNativeSeparators(dir.absolutePath());
+    request.includeList = parser.value("include");
+    request.excludeList = parser.value("exclude");
+    request.options.caseSensitive = parser.isSet("case-sensitive");
+    request.options.wholeWord = parser.isSet("word");
+    request.options.useRegex = parser.isSet("regex");
+    request.options.multiline = parser.isSet("multiline");
+    request.options.searchInBinaries = parser.isSet("binary");
+    request.useIgnoreFiles = !parser.isSet("no-ignore");
+
+    if (request.searchText.empty()) {
+        std::fprintf(stderr, "%s\n", qPrintable(app.tr("Nothing to search for")));
+        return 2;
+    }
+    auto matcher = SearchMatcher(request.searchText, request.options);
+    if (!matcher.isValid()) {
+        std::fprintf(stderr, "%s\n", qPrintable(matcher.errorString()));
+        return 2;
+    }
+    if (!QDir(request.startPath).exists()) {
+        std::fprintf(stderr, "%s\n",
+                     qPrintable(app.tr("No such directory: %1").arg(request.startPath)));
+        return 2;
+    }
+
+    auto timer = QElapsedTimer();
+    timer.start();
+    if (parser.isSet("index")) {
+        auto index = std::make_shared<TrigramIndex>(request.startPath);
+        index->update();
+        std::fprintf(stderr, "%s\n",
+                     qPrintable(app.tr("Indexed %1 files in %2 ms")
+                                    .arg(index->getFileCount())
+                                    .arg(timer.restart())));
+        request.index = index;
+    }
+
+    auto engine = SearchEngine(parser.value("threads").toUInt());
+    auto quiet = parser.isSet("quiet");
+    auto fileCount = size_t(0);
+    auto matchCount = size_t(0);
+    // Files are reported one at a time, and in order, so no locking is needed
+    auto onFile = [&](SearchFileResult &&result) {
+        fileCount++;
+        matchCount += result.found.size();
+        if (quiet) {
+            return;
+        }
+        auto fileName = result.shortFileName.toUtf8();
+        for (auto const &found : result.found) {
+            std::fprintf(stdout, "%s:%zu:", fileName.constData(), found.lineNumber + 1);
+            std::fwrite(found.line.data(), 1, found.line.size(), stdout);
+            std::fputc('\n', stdout);
+        }
+    };
+    engine.start(request, onFile, {});
+    engine.wait();
+    std::fflush(stdout);
+
+    std::fprintf(stderr, "%s\n",
+                 qPrintable(app.tr("Found %1 matches in %2 files, in %3 ms (%4 threads)")
+                                .arg(matchCount)
+                                .arg(fileCount)
+                                .arg(timer.elapsed())
+                                .arg(engine.getThreadCount())));
+    return matchCount != 0 ? 0 : 1;
+}
@@ -0,0 +1,20 @@
+/**
+ * \file SearchCommandLine.h
+ * \brief Definition of the headless project search, run from the command line
+ * \author Diego Iastrubni (diegoiast@gmail.com)
+ *  License MIT
+ */
+
+#pragma once
+
+// True if the arguments ask for a search (--grep), instead of starting the GUI
+auto isSearchCommandLine(int argc, char *argv[]) -> bool;
+
+/**
+ * Runs a single project search, with the same engine the search panel uses, and prints the
+ * matches as "file:line:text", followed by timing on stderr. No GUI (and no display) is
+ * needed, this is meant for scripting and benchmarking.
+ *
+ * Returns 0 if anything was found, 1 if not, 2 on errors - like grep.
+ */
+auto runSearchCommandLine(int argc, char *argv[]) -> int;
@@ -0,0 +1,558 @@
+/**
+ * \file SearchEngine.cpp
+ * \brief Implementation of the parallel project search engine
+ * \author Diego Iastrubni (diegoiast@gmail.com)
+ *  License MIT
+ */
+
+#include <algorithm>
+#include <cstring>
+
+#include <QDir>
+#include <QFileInfo>
+#include <QSet>
+#include <QStringList>
+
+#include "DirectoryWalker.hpp"
+#include "GlobSet.hpp"
+#include "MappedFile.hpp"
+#include "SearchEngine.h"
+#include "SearchMatcher.h"
+#include "SearchResultCache.h"
+#include "StringFinder.h"
+#include "TextClassifier.hpp"
+#include "TrigramIndex.h"
+
+// Counts the new lines in a range, and remembers where the last one was found
+static auto countLines(const char *begin, const char *end, const char *&lastNewLine) -> size_t {
+    auto count = size_t(0);
+    while (begin < end) {
+        auto p = static_cast<const char *>(std::memchr(begin, '\n', end - begin));
+        if (!p) {
+            break;
+        }
+        count++;
+        lastNewLine = p;
+        begin = p + 1;
+    }
+    return count;
+}
+
+// Scans the whole buffer for the literal, and only splits lines around hits.
+// The callback is called once per line containing the literal.
+static auto forEachCandidateLine(
+    std::string_view buffer, const StringFinder &finder,
+    const std::function<void(const char *lineStart, const char *lineEnd, size_t lineNumber)>
+        &callback) -> void {
+    if (finder.needle().find('\n') != std::string_view::npos) {
+        return;
+    }
+
+    auto const data = buffer.data();
+    auto lineNumber = size_t(0);
+    auto lineStart = data;
+    auto pos = finder.find(buffer, 0);
+    while (pos != std::string_view::npos) {
+        auto const hit = data + pos;
+        auto lastNewLine = static_cast<const char *>(nullptr);
+        lineNumber += countLines(lineStart, hit, lastNewLine);
+        if (lastNewLine) {
+            lineStart = lastNewLine + 1;
+        }
+
+        auto lineEnd = static_cast<const char *>(
+            std::memchr(hit, '\n', buffer.size() - (hit - data)));
+        if (!lineEnd) {
+            lineEnd = data + buffer.size();
+        }
+        callback(lineStart, lineEnd, lineNumber);
+
+        if (lineEnd == data + buffer.size()) {
+            break;
+        }
+        lineNumber++;
+        lineStart = lineEnd + 1;
+        pos = finder.find(buffer, lineStart - data);
+    }
+}
+
+auto static searchTextFile(std::string_view buffer, const SearchMatcher &matcher,
+                           std::function<void(const std::string &, size_t)> callback) -> void {
+    auto const &literal = matcher.getLiteral();
+    if (matcher.isLiteralOnly()) {
+        forEachCandidateLine(buffer, literal, [&](auto lineStart, auto lineEnd, auto lineNumber) {
+            callback(std::string(lineStart, lineEnd), lineNumber);
+        });
+        return;
+    }
+
+    if (!literal.isEmpty()) {
+        forEachCandidateLine(buffer, literal, [&](auto lineStart, auto lineEnd, auto lineNumber) {
+            if (matcher.matches(QString::fromUtf8(lineStart, lineEnd - lineStart))) {
+                callback(std::string(lineStart, lineEnd), lineNumber);
+            }
+        });
+        return;
+    }
+
+    // Nothing to pre-filter with. Decode the buffer once, and match each line as a view.
+    // New lines are kept as is by the UTF-8 decoder, so both buffers have the same lines.
+    auto const text = QString::fromUtf8(buffer.data(), buffer.size());
+    auto const data = buffer.data();
+    auto const end = data + buffer.size();
+    auto lineStart = data;
+    auto textStart = qsizetype(0);
+    auto lineNumber = size_t(0);
+    while (lineStart < end) {
+        auto lineEnd = static_cast<const char *>(std::memchr(lineStart, '\n', end - lineStart));
+        if (!lineEnd) {
+            lineEnd = end;
+        }
+        auto textEnd = text.indexOf(u'\n', textStart);
+        if (textEnd < 0) {
+            textEnd = text.size();
+        }
+        if (matcher.matches(QStringView(text).sliced(textStart, textEnd - textStart))) {
+            callback(std::string(lineStart, lineEnd), lineNumber);
+        }
+        lineNumber++;
+        lineStart = lineEnd + 1;
+        textStart = textEnd + 1;
+    }
+}
+
+// The whole file is in memory, so the context after a match is just the next bytes of the
+// buffer, even if the match is near the end of a read chunk.
+auto static searchBinaryFile(std::string_view buffer, const StringFinder &finder,
+                             std::function<void(const std::string &, size_t)> callback) -> void {
+    if (finder.isEmpty()) {
+        return;
+    }
+
+    auto constexpr contextSize = size_t(100);
+    auto const searchLen = finder.needle().size();
+    auto pos = finder.find(buffer, 0);
+    while (pos != std::string_view::npos) {
+        auto context = buffer.substr(pos + searchLen, contextSize);
+        callback(std::string(context), pos);
+        pos = finder.find(buffer, pos + 1);
+    }
+}
+
+namespace {
+
+// Follows the start of the same line in a UTF-16 text, and in the UTF-8 buffer it was decoded
+// from. New lines are kept as is by the decoder, so both have the same lines.
+struct LineCursor {
+    QStringView text;
+    std::string_view buffer;
+    qsizetype textLineStart = 0;
+    size_t bufferLineStart = 0;
+    size_t lineNumber = 0;
+
+    // Moves to the line containing the char at `offset` in the text
+    auto advanceTo(qsizetype offset) -> void {
+        auto newLine = text.indexOf(u'\n', textLineStart);
+        while (newLine >= 0 && newLine < offset) {
+            textLineStart = newLine + 1;
+            bufferLineStart = buffer.find('\n', bufferLineStart) + 1;
+            lineNumber++;
+            newLine = text.indexOf(u'\n', textLineStart);
+        }
+    }
+
+    auto bufferLineEnd() const -> size_t {
+        auto end = buffer.find('\n', bufferLineStart);
+        return end == std::string_view::npos ? buffer.size() : end;
+    }
+};
+
+} // namespace
+
+// Runs the regex over the whole file, so a match may span lines. Matches touching the same
+// lines are reported once, and only the matched lines are copied out of the buffer.
+auto static searchMultilineFile(std::string_view buffer, const SearchMatcher &matcher,
+                                QList<FoundData> &found) -> void {
+    auto const &literal = matcher.getLiteral();
+    if (!literal.isEmpty() && literal.find(buffer, 0) == std::string_view::npos) {
+        return;
+    }
+
+    auto const text = QString::fromUtf8(buffer.data(), buffer.size());
+    auto cursor = LineCursor{text, buffer};
+    auto hit = FoundData();
+    auto hitStart = size_t(0);
+    auto hitEnd = size_t(0);
+    auto hasHit = false;
+    auto flush = [&]() {
+        if (hasHit) {
+            hit.line = std::string(buffer.substr(hitStart, hitEnd - hitStart));
+            found.push_back(std::move(hit));
+        }
+    };
+
+    auto it = matcher.getRegex().globalMatchView(text);
+    while (it.hasNext()) {
+        auto match = it.next();
+        auto start = match.capturedStart();
+        auto last = std::max(start, match.capturedEnd() - 1);
+
+        cursor.advanceTo(start);
+        auto firstLine = cursor.lineNumber;
+        auto firstLineStart = cursor.bufferLineStart;
+        cursor.advanceTo(last);
+        auto lastLine = cursor.lineNumber;
+
+        if (hasHit && firstLine < hit.lineNumber + hit.lineCount) {
+            hit.lineCount = std::max(hit.lineCount, lastLine - hit.lineNumber + 1);
+            hitEnd = std::max(hitEnd, cursor.bufferLineEnd());
+            continue;
+        }
+        flush();
+        hit = FoundData{{}, firstLine, lastLine - firstLine + 1};
+        hitStart = firstLineStart;
+        hitEnd = cursor.bufferLineEnd();
+        hasHit = true;
+    }
+    flush();
+}
+
+// Snapshots are taken from editors, so they are always text
+auto static searchSnapshot(const QString &text, const SearchMatcher &matcher,
+                           CachedSearchFile &result) -> void {
+    auto const utf8 = text.toUtf8();
+    auto const buffer = std::string_view(utf8.constData(), utf8.size());
+    if (matcher.isMultiline()) {
+        searchMultilineFile(buffer, matcher, result.found);
+        return;
+    }
+    searchTextFile(buffer, matcher, [&result](const std::string &line, size_t lineNumber) {
+        result.found.push_back({line, lineNumber});
+    });
+}
+
+// Fills the size and modification time of the result as well, as seen by the search
+auto static searchFile(const QString &fileName, MappedFile &file, const SearchMatcher &matcher,
+                       CachedSearchFile &result) -> void {
+    if (!file.open(fileName.toStdString())) {
+        return;
+    }
+    result.size = static_cast<int64_t>(file.size());
+    result.modified = file.lastModified();
+
+    auto addLine = [&result](const std::string &line, size_t lineNumber) {
+        result.found.push_back({line, lineNumber});
+    };
+    auto const buffer = file.view();
+    if (TextClassifier::isTextFile(fileName, file.lastModified(), buffer)) {
+        if (matcher.isMultiline()) {
+            searchMultilineFile(buffer, matcher, result.found);
+        } else {
+            searchTextFile(buffer, matcher, addLine);
+        }
+    } else if (matcher.getOptions().searchInBinaries) {
+        searchBinaryFile(buffer, StringFinder(matcher.getSearchText()),
+                         [&result](const std::string &context, size_t offset) {
+                             result.found.push_back({context, offset, 1, true});
+                         });
+    }
+    file.close();
+}
+
+SearchEngine::SearchEngine(unsigned int threadCount) {
+    if (threadCount == 0) {
+        threadCount = std::thread::hardware_concurrency();
+    }
+    this->threadCount = std::max(1u, threadCount);
+}
+
+SearchEngine::~SearchEngine() {
+    stop();
+    wait();
+}
+
+auto SearchEngine::start(const SearchRequest &request, FileCallback onFile,
+                         FinishedCallback onFinished) -> void {
+    stop();
+    joinFinishedDrivers();
+
+    auto run = std::make_shared<SearchRun>();
+    run->request = request;
+    run->fileCallback = std::move(onFile);
+    for (auto i = 0u; i < threadCount; i++) {
+        run->queues.push_back(std::make_unique<WorkQueue>());
+    }
+    current = run;
+    drivers.push_back({std::thread([this, run, onFinished]() { execute(*run, onFinished); }),
+                       run});
+}
+
+auto SearchEngine::stop() -> void {
+    if (!current || current->finished) {
+        return;
+    }
+    current->cancelled = true;
+    {
+        auto lock = std::unique_lock(current->idleMutex);
+    }
+    current->idleCondition.notify_all();
+}
+
+auto SearchEngine::wait() -> void {
+    for (auto &driver : drivers) {
+        driver.thread.join();
+    }
+    drivers.clear();
+}
+
+auto SearchEngine::joinFinishedDrivers() -> void {
+    std::erase_if(drivers, [](Driver &driver) {
+        if (!driver.run->finished) {
+            return false;
+        }
+        driver.thread.join();
+        return true;
+    });
+}
+
+auto SearchEngine::execute(SearchRun &run, const FinishedCallback &onFinished) -> void {
+    auto matcher = SearchMatcher(run.request.searchText, run.request.options);
+    if (!matcher.isValid()) {
+        run.finished = true;
+        if (onFinished) {
+            onFinished(false);
+        }
+        return;
+    }
+
+    auto workers = std::vector<std::thread>();
+    for (auto i = 0u; i < threadCount; i++) {
+        workers.emplace_back([this, &run, i]() { work(run, i); });
+    }
+
+    auto cacheKey = QString();
+    if (run.request.cache) {
+        cacheKey = SearchResultCache::makeKey(run.request);
+        run.cached = run.request.cache->find(cacheKey);
+    }
+
+    produce(run, matcher);
+    {
+        auto lock = std::unique_lock(run.idleMutex);
+        run.producerDone = true;
+    }
+    run.idleCondition.notify_all();
+
+    for (auto &w : workers) {
+        w.join();
+    }
+
+    auto cancelled = run.cancelled.load();
+    if (run.request.cache && !cancelled && !run.collectedTooMany) {
+        run.request.cache->store(
+            cacheKey, std::make_shared<SearchResultCache::Entry>(std::move(run.collected)));
+    }
+    run.finished = true;
+    if (onFinished) {
+        onFinished(cancelled);
+    }
+}
+
+auto SearchEngine::produce(SearchRun &run, const SearchMatcher &matcher) -> void {
+    auto const &request = run.request;
+    auto const startSearchPath = QDir::toNativeSeparators(QDir::cleanPath(request.startPath));
+    auto allowList = request.includeList.isEmpty() ? QString("*") : request.includeList;
+    // Files must be below the start, not in a sibling sharing its name as a prefix
+    auto startPrefix = startSearchPath;
+    if (!startPrefix.endsWith('\\') && !startPrefix.endsWith('/')) {
+        startPrefix += QDir::separator();
+    }
+
+    // The lists are compiled once, not for every file. Short exclude rules are ignored,
+    // as they would exclude most of the tree.
+    auto excludeRules = GlobSet::splitList(request.excludeList);
+    excludeRules.removeIf([](const QString &rule) { return rule.length() < 3; });
+    auto const excluded = GlobSet(excludeRules, GlobSet::MatchType::Anywhere);
+    auto const included = GlobSet(GlobSet::splitList(allowList), GlobSet::MatchType::Anywhere);
+    auto const fileNames = GlobSet(GlobSet::splitList(QString(allowList).replace(' ', ';')),
+                                   GlobSet::MatchType::Whole, Qt::CaseInsensitive);
+    auto nameMatches = [&fileNames](const QString &fullFileName) {
+        auto name = QStringView(fullFileName);
+        auto separator = std::max(name.lastIndexOf('/'), name.lastIndexOf('\\'));
+        return fileNames.matches(name.sliced(separator + 1));
+    };
+
+    auto index = size_t(0);
+    auto pushTask = [&](SearchTask &&task) {
+        auto &queue = *run.queues[index % run.queues.size()];
+        {
+            auto lock = std::unique_lock(queue.mutex);
+            queue.tasks.push_back(std::move(task));
+        }
+        run.queuedTasks++;
+        {
+            auto lock = std::unique_lock(run.idleMutex);
+        }
+        run.idleCondition.notify_one();
+        index++;
+    };
+
+    // Files from the last run of this search come first, so the unchanged ones are reported
+    // right away. The walk below then only adds files which were not seen before.
+    auto queuedFiles = QSet<QString>();
+    if (run.cached) {
+        for (auto const &file : *run.cached) {
+            if (run.cancelled) {
+                return;
+            }
+            queuedFiles.insert(file.fullFileName);
+            pushTask({index, file.fullFileName, file.shortFileName, &file});
+        }
+    }
+
+    auto addTask = [&](const QString &fullFileName) {
+        if (!fullFileName.startsWith(startPrefix) || queuedFiles.contains(fullFileName)) {
+            return;
+        }
+        if (excluded.matches(fullFileName) || !included.matches(fullFileName)) {
+            return;
+        }
+
+        pushTask({index, fullFileName, fullFileName.mid(startPrefix.size())});
+    };
+
+    // Open files may have unsaved content the index and the cache know nothing about, or may
+    // not be on disk at all. Only those the walk would report are searched, so hidden and
+    // ignored files are not found just because they are open.
+    if (request.snapshots) {
+        auto walker = DirectoryWalker(startSearchPath);
+        walker.setUseIgnoreFiles(request.useIgnoreFiles);
+        for (auto it = request.snapshots->cbegin(); it != request.snapshots->cend(); ++it) {
+            auto const &fullFileName = it.key();
+            if (!fullFileName.startsWith(startPrefix) || !nameMatches(fullFileName)) {
+                continue;
+            }
+            auto relativeFileName = fullFileName.mid(startPrefix.size());
+            if (walker.isWalked(QDir::fromNativeSeparators(relativeFileName))) {
+                addTask(fullFileName);
+                queuedFiles.insert(fullFileName);
+            }
+        }
+    }
+
+    // The index never lists ignored files, so it cannot be used when they are searched
+    auto candidates = std::vector<QString>();
+    if (request.index && request.useIgnoreFiles &&
+        request.index->candidates(matcher.getLiteral().needle(), request.options.searchInBinaries,
+                                  startSearchPath, candidates)) {
+        for (auto const &fullFileName : candidates) {
+            if (run.cancelled) {
+                break;
+            }
+            if (nameMatches(fullFileName)) {
+                addTask(fullFileName);
+            }
+        }
+        return;
+    }
+
+    auto walker = DirectoryWalker(startSearchPath);
+    walker.setUseIgnoreFiles(request.useIgnoreFiles);
+    walker.walk([&](const QString &fullFileName, const QString &) {
+        if (nameMatches(fullFileName)) {
+            addTask(QDir::toNativeSeparators(fullFileName));
+        }
+        return !run.cancelled;
+    });
+}
+
+auto SearchEngine::work(SearchRun &run, size_t workerId) -> void {
+    auto task = SearchTask();
+    auto file = MappedFile();
+    auto matcher = SearchMatcher(run.request.searchText, run.request.options);
+    while (!run.cancelled) {
+        if (!takeTask(run, workerId, task)) {
+            auto lock = std::unique_lock(run.idleMutex);
+            run.idleCondition.wait(lock, [&run]() {
+                return run.queuedTasks > 0 || run.producerDone || run.cancelled;
+            });
+            if (run.queuedTasks == 0 && run.producerDone) {
+                break;
+            }
+            continue;
+        }
+
+        auto result = CachedSearchFile{task.fullFileName, task.shortFileName};
+        auto const &snapshots = run.request.snapshots;
+        if (snapshots) {
+            auto snapshot = snapshots->constFind(task.fullFileName);
+            if (snapshot != snapshots->cend()) {
+                searchSnapshot(*snapshot, matcher, result);
+                completeTask(run, task.index, std::move(result));
+                continue;
+            }
+        }
+        if (task.cached) {
+            // A single stat() tells if the file must be searched again
+            auto info = QFileInfo(task.fullFileName);
+            if (!info.exists()) {
+                completeTask(run, task.index, std::move(result));
+                continue;
+            }
+            if (info.size() == task.cached->size &&
+                info.lastModified().toMSecsSinceEpoch() == task.cached->modified) {
+                completeTask(run, task.index, CachedSearchFile(*task.cached));
+                continue;
+            }
+        }
+        searchFile(task.fullFileName, file, matcher, result);
+        completeTask(run, task.index, std::move(result));
+    }
+}
+
+auto SearchEngine::takeTask(SearchRun &run, size_t workerId, SearchTask &task) -> bool {
+    // Own work is taken from the front, to keep results close to the producer order,
+    // other workers steal from the back.
+    auto count = run.queues.size();
+    for (auto i = size_t(0); i < count; i++) {
+        auto &queue = *run.queues[(workerId + i) % count];
+        auto lock = std::unique_lock(queue.mutex);
+        if (queue.tasks.empty()) {
+            continue;
+        }
+        if (i == 0) {
+            task = std::move(queue.tasks.front());
+            queue.tasks.pop_front();
+        } else {
+            task = std::move(queue.tasks.back());
+            queue.tasks.pop_back();
+        }
+        run.queuedTasks--;
+        return true;
+    }
+    return false;
+}
+
+auto SearchEngine::completeTask(SearchRun &run, size_t index, CachedSearchFile &&result)
+    -> void {
+    auto lock = std::unique_lock(run.mergeMutex);
+    run.pendingResults.emplace(index, std::move(result));
+
+    auto it = run.pendingResults.begin();
+    while (it != run.pendingResults.end() && it->first == run.nextResult) {
+        auto &file = it->second;
+        if (run.request.cache && file.size >= 0 && !run.collectedTooMany) {
+            run.collected.push_back(file);
+            if (run.collected.size() > SearchResultCache::MaxFiles) {
+                run.collectedTooMany = true;
+                run.collected = {};
+            }
+        }
+        if (!run.cancelled && !file.found.isEmpty() && run.fileCallback) {
+            run.fileCallback({std::move(file.fullFileName), std::move(file.shortFileName),
+                              std::move(file.found)});
+        }
+        it = run.pendingResults.erase(it);
+        run.nextResult++;
+    }
+}
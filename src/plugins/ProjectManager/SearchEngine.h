@@ -0,0 +1,155 @@
+/**
+ * \file SearchEngine.h
+ * \brief Definition of the parallel project search engine
+ * \author Diego Iastrubni (diegoiast@gmail.com)
+ *  License MIT
+ */
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <QHash>
+#include <QList>
+#include <QString>
+
+#include "SearchMatcher.h"
+
+class SearchResultCache;
+class TrigramIndex;
+
+struct FoundData {
+    std::string line;
+    size_t lineNumber = 0;
+    // Multiline matches keep all the lines they span in `line`, new lines included
+    size_t lineCount = 1;
+    // Matches in binary files keep the byte offset in `lineNumber`, and the bytes after the
+    // match in `line`
+    bool binary = false;
+};
+
+struct SearchRequest {
+    QString startPath;
+    std::string searchText;
+    QString includeList;
+    QString excludeList;
+    SearchOptions options;
+    // Skip files and directories listed in .gitignore and .ignore files
+    bool useIgnoreFiles = true;
+    // When set, and the query has a usable literal, only files the index lists are searched
+    std::shared_ptr<const TrigramIndex> index;
+    // When set, files unchanged since the same search last ran are not searched again
+    std::shared_ptr<SearchResultCache> cache;
+    // Content of files modified in editors, by full (native) file name. These are searched
+    // instead of the files on disk.
+    std::shared_ptr<const QHash<QString, QString>> snapshots;
+};
+
+struct SearchFileResult {
+    QString fullFileName;
+    QString shortFileName;
+    QList<FoundData> found;
+};
+
+// A searched file, and what was found in it (maybe nothing), as kept by SearchResultCache
+struct CachedSearchFile {
+    QString fullFileName;
+    QString shortFileName;
+    // -1 when the file could not be read, or was searched from a snapshot. Such files are
+    // not cached.
+    int64_t size = -1;
+    // Milliseconds since the epoch
+    int64_t modified = 0;
+    QList<FoundData> found;
+};
+
+/**
+ * A single producer walks the directory tree (or asks the index for candidate files), and
+ * hands files to a set of workers. Each worker owns a deque of files, and when it runs out
+ * of work, it steals from the back of its siblings' deques. Results are re-ordered, and
+ * reported in the same order the producer found the files.
+ *
+ * Starting a search cancels the previous one without waiting for it. Callbacks are called
+ * from the engine's threads, not the thread that started the search, and a cancelled search
+ * reports no more files.
+ */
+class SearchEngine {
+  public:
+    using FileCallback = std::function<void(SearchFileResult &&result)>;
+    using FinishedCallback = std::function<void(bool stopped)>;
+
+    explicit SearchEngine(unsigned int threadCount = 0);
+    ~SearchEngine();
+
+    auto start(const SearchRequest &request, FileCallback onFile, FinishedCallback onFinished)
+        -> void;
+    auto stop() -> void;
+    auto wait() -> void;
+    auto isRunning() const -> bool { return current && !current->finished; }
+    auto getThreadCount() const -> unsigned int { return threadCount; }
+
+  private:
+    struct SearchTask {
+        size_t index = 0;
+        QString fullFileName;
+        QString shortFileName;
+        // Found by the previous run of the same search, owned by SearchRun::cached
+        const CachedSearchFile *cached = nullptr;
+    };
+
+    struct WorkQueue {
+        std::mutex mutex;
+        std::deque<SearchTask> tasks;
+    };
+
+    // Everything a single search needs. Each search owns its cancel token, so a new search
+    // can start right away, while the threads of a cancelled one are still winding down.
+    struct SearchRun {
+        SearchRequest request;
+        FileCallback fileCallback;
+        std::atomic<bool> cancelled = false;
+        std::atomic<bool> finished = false;
+
+        std::vector<std::unique_ptr<WorkQueue>> queues;
+        std::atomic<size_t> queuedTasks = 0;
+        std::atomic<bool> producerDone = false;
+        std::mutex idleMutex;
+        std::condition_variable idleCondition;
+
+        std::mutex mergeMutex;
+        std::map<size_t, CachedSearchFile> pendingResults;
+        size_t nextResult = 0;
+
+        std::shared_ptr<const std::vector<CachedSearchFile>> cached;
+        std::vector<CachedSearchFile> collected;
+        // Set when more files were searched than the cache keeps
+        bool collectedTooMany = false;
+    };
+
+    struct Driver {
+        std::thread thread;
+        std::shared_ptr<SearchRun> run;
+    };
+
+    auto execute(SearchRun &run, const FinishedCallback &onFinished) -> void;
+    auto produce(SearchRun &run, const SearchMatcher &matcher) -> void;
+    auto work(SearchRun &run, size_t workerId) -> void;
+    auto takeTask(SearchRun &run, size_t workerId, SearchTask &task) -> bool;
+    auto completeTask(SearchRun &run, size_t index, CachedSearchFile &&result) -> void;
+    auto joinFinishedDrivers() -> void;
+
+    unsigned int threadCount = 1;
+    std::shared_ptr<SearchRun> current;
+    std::vector<Driver> drivers;
+};
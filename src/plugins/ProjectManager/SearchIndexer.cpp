@@ -0,0 +1,207 @@
+/**
+ * \file SearchIndexer.cpp
+ * \brief Keeps the trigram indexes of the loaded projects up to date
+ * \author Diego Iastrubni (diegoiast@gmail.com)
+ *  License MIT
+ */
+
+#include <QDir>
+#include <QFileInfo>
+#include <QFutureWatcher>
+#include <QTimer>
+#include <QtConcurrent/QtConcurrentRun>
+
+#include "DirectoryWatcher.hpp"
+#include "ProjectBuildConfig.h"
+#include "ProjectManagerPlg.h"
+#include "SearchIndexer.h"
+#include "TrigramIndex.h"
+
+static constexpr auto IndexFileName = "codepointer-search.index";
+static constexpr auto ChangesDelay = 500;
+static constexpr auto UnwatchedUpdateInterval = 10 * 1000;
+
+static auto cleanDir(const QString &dir) -> QString {
+    return QDir::cleanPath(QDir::fromNativeSeparators(dir));
+}
+
+SearchIndexer::SearchIndexer(ProjectBuildModel *model, QObject *parent)
+    : QObject(parent), model(model) {}
+
+SearchIndexer::~SearchIndexer() {
+    for (auto const &sourceDir : projects.keys()) {
+        removeProject(sourceDir);
+    }
+}
+
+auto SearchIndexer::setEnabled(bool enabled) -> void {
+    if (this->enabled == enabled) {
+        return;
+    }
+    this->enabled = enabled;
+    updateProjects();
+}
+
+auto SearchIndexer::updateProjects() -> void {
+    auto wanted = QMap<QString, QString>();
+    if (enabled) {
+        for (auto i = 0; i < model->rowCount(); i++) {
+            auto config = model->getConfig(i);
+            auto buildDir = config->expand(config->buildDir);
+            if (config->sourceDir.isEmpty() || buildDir.isEmpty()) {
+                continue;
+            }
+            wanted[cleanDir(config->expand(config->sourceDir))] = buildDir;
+        }
+    }
+
+    for (auto const &sourceDir : projects.keys()) {
+        if (!wanted.contains(sourceDir)) {
+            removeProject(sourceDir);
+        }
+    }
+    for (auto it = wanted.cbegin(); it != wanted.cend(); ++it) {
+        if (!projects.contains(it.key())) {
+            addProject(it.key(), it.value());
+        }
+    }
+}
+
+auto SearchIndexer::indexForSearch(const QString &path) -> std::shared_ptr<const TrigramIndex> {
+    if (!enabled) {
+        return {};
+    }
+
+    auto searchDir = cleanDir(path);
+    for (auto project : std::as_const(projects)) {
+        auto const &root = project->index->getRootDir();
+        if (searchDir != root && !searchDir.startsWith(root + '/')) {
+            continue;
+        }
+        if (!project->index->isReady()) {
+            return {};
+        }
+        // Without a watcher, changes are only found by re-validating, and the index may
+        // miss new files until then
+        if (!project->watcher && project->lastFullUpdate.isValid() &&
+            project->lastFullUpdate.elapsed() > UnwatchedUpdateInterval) {
+            project->fullUpdatePending = true;
+            scheduleUpdate(project);
+            return {};
+        }
+        // Files changed lately may not be indexed yet
+        if (project->job.isRunning() || project->fullUpdatePending ||
+            !project->changedDirectories.isEmpty() ||
+            (project->watcher && project->watcher->hasPendingChanges())) {
+            return {};
+        }
+        return project->index;
+    }
+    return {};
+}
+
+auto SearchIndexer::addProject(const QString &sourceDir, const QString &buildDir) -> void {
+    auto project = new IndexedProject;
+    project->index = std::make_shared<TrigramIndex>(sourceDir);
+    project->indexFile = QDir(buildDir).filePath(IndexFileName);
+    // The index file changes on every save. The build directory is skipped as a whole, unless
+    // it holds the sources.
+    auto const absoluteBuildDir = cleanDir(QFileInfo(buildDir).absoluteFilePath());
+    auto excludedPaths = QStringList{absoluteBuildDir + '/' + IndexFileName};
+    if (absoluteBuildDir.startsWith(sourceDir + '/')) {
+        excludedPaths.append(absoluteBuildDir);
+    }
+    project->index->setExcludedPaths(excludedPaths);
+    project->watcher = new DirectoryWatcher(sourceDir, this);
+    project->watcher->setReportContentChanges(true);
+    project->updateTimer = new QTimer(this);
+    project->updateTimer->setSingleShot(true);
+    project->updateTimer->setInterval(ChangesDelay);
+    project->fullUpdatePending = true;
+    projects[sourceDir] = project;
+
+    connect(project->watcher, &DirectoryWatcher::directoriesChanged, this,
+            [project, sourceDir](const QStringList &dirs) {
+                for (auto const &dir : dirs) {
+                    project->changedDirectories.insert(dir.isEmpty() ? sourceDir
+                                                                     : sourceDir + '/' + dir);
+                }
+                project->updateTimer->start();
+            });
+    connect(project->watcher, &DirectoryWatcher::overflowed, this, [project]() {
+        project->fullUpdatePending = true;
+        project->updateTimer->start();
+    });
+    connect(project->updateTimer, &QTimer::timeout, this,
+            [this, project]() { scheduleUpdate(project); });
+
+    scheduleUpdate(project);
+}
+
+auto SearchIndexer::removeProject(const QString &sourceDir) -> void {
+    auto project = projects.take(sourceDir);
+    if (!project) {
+        return;
+    }
+    project->index->cancel();
+    project->job.waitForFinished();
+    delete project->watcher;
+    delete project->updateTimer;
+    delete project;
+}
+
+auto SearchIndexer::scheduleUpdate(IndexedProject *project) -> void {
+    // The next update starts when the current one is done
+    if (project->job.isRunning()) {
+        return;
+    }
+
+    auto full = project->fullUpdatePending;
+    auto directories = full ? QStringList() : project->changedDirectories.values();
+    if (!full && directories.isEmpty()) {
+        return;
+    }
+    project->fullUpdatePending = false;
+    project->changedDirectories.clear();
+
+    auto index = project->index;
+    auto indexFile = project->indexFile;
+    auto firstRun = !index->isReady();
+    project->job = QtConcurrent::run([index, indexFile, directories, firstRun]() {
+        if (firstRun) {
+            index->load(indexFile);
+        }
+        auto changes = index->update(directories);
+        if (changes > 0 || firstRun) {
+            QDir().mkpath(QFileInfo(indexFile).path());
+            index->save(indexFile);
+        }
+    });
+
+    auto sourceDir = index->getRootDir();
+    auto jobWatcher = new QFutureWatcher<void>(this);
+    connect(jobWatcher, &QFutureWatcher<void>::finished, this,
+            [this, jobWatcher, sourceDir, full]() {
+                jobWatcher->deleteLater();
+                auto project = projects.value(sourceDir);
+                if (!project) {
+                    return;
+                }
+                if (full) {
+                    project->lastFullUpdate.start();
+                }
+                watchDirectories(project);
+                scheduleUpdate(project);
+            });
+    jobWatcher->setFuture(project->job);
+}
+
+auto SearchIndexer::watchDirectories(IndexedProject *project) -> void {
+    if (!project->watcher) {
+        return;
+    }
+    if (!project->watcher->watch(project->index->getDirectories())) {
+        delete project->watcher;
+        project->watcher = nullptr;
+    }
+}
@@ -0,0 +1,67 @@
+/**
+ * \file SearchIndexer.h
+ * \brief Keeps the trigram indexes of the loaded projects up to date
+ * \author Diego Iastrubni (diegoiast@gmail.com)
+ *  License MIT
+ */
+
+#pragma once
+
+#include <memory>
+
+#include <QElapsedTimer>
+#include <QFuture>
+#include <QMap>
+#include <QObject>
+#include <QSet>
+
+class DirectoryWatcher;
+class QTimer;
+class ProjectBuildModel;
+class TrigramIndex;
+
+/**
+ * Owns a TrigramIndex for every loaded project, stored in the project's build directory.
+ *
+ * Indexes are loaded (or built) in the background. Each project's tree is watched by a
+ * DirectoryWatcher (one inotify descriptor, no per directory objects), which also reports
+ * files written in place, and only the changed directories are refreshed. Searches do not
+ * use the index while changes are waiting to be applied. The build directory (which holds
+ * the index file) is never indexed, so saving the index does not trigger another update.
+ *
+ * When the tree cannot be watched (no inotify, or the watch limit was reached), the index is
+ * re-validated on demand instead, and is not used by searches until that is done.
+ */
+class SearchIndexer : public QObject {
+    Q_OBJECT
+
+  public:
+    explicit SearchIndexer(ProjectBuildModel *model, QObject *parent = nullptr);
+    ~SearchIndexer();
+
+    auto setEnabled(bool enabled) -> void;
+    auto isEnabled() const -> bool { return enabled; }
+    auto updateProjects() -> void;
+    auto indexForSearch(const QString &path) -> std::shared_ptr<const TrigramIndex>;
+
+  private:
+    struct IndexedProject {
+        std::shared_ptr<TrigramIndex> index;
+        QString indexFile;
+        DirectoryWatcher *watcher = nullptr;
+        QTimer *updateTimer = nullptr;
+        QSet<QString> changedDirectories;
+        bool fullUpdatePending = false;
+        QFuture<void> job;
+        QElapsedTimer lastFullUpdate;
+    };
+
+    auto addProject(const QString &sourceDir, const QString &buildDir) -> void;
+    auto removeProject(const QString &sourceDir) -> void;
+    auto scheduleUpdate(IndexedProject *project) -> void;
+    auto watchDirectories(IndexedProject *project) -> void;
+
+    ProjectBuildModel *model;
+    bool enabled = false;
+    QMap<QString, IndexedProject *> projects;
+};
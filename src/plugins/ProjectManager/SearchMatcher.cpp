@@ -0,0 +1,273 @@
+/**
+ * \file SearchMatcher.cpp
+ * \brief Implementation of the compiled project search query
+ * \author Diego Iastrubni (diegoiast@gmail.com)
+ *  License MIT
+ */
+
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+
+#include "SearchMatcher.h"
+
+static auto isAscii(std::string_view s) -> bool {
+    return std::all_of(s.begin(), s.end(), [](char c) { return (c & 0x80) == 0; });
+}
+
+// Case insensitive matching folds more than ASCII ('k' also matches the Kelvin sign, 's' the
+// long s), so only runs of the other ASCII chars can be pre-filtered.
+static auto longestCaselessRun(std::string_view s) -> std::string {
+    auto breaksRun = [](char c) {
+        return (c & 0x80) != 0 || c == 'k' || c == 'K' || c == 's' || c == 'S';
+    };
+    auto best = std::string_view();
+    auto start = size_t(0);
+    for (auto i = size_t(0); i <= s.size(); i++) {
+        if (i == s.size() || breaksRun(s[i])) {
+            if (i - start > best.size()) {
+                best = s.substr(start, i - start);
+            }
+            start = i + 1;
+        }
+    }
+    return std::string(best);
+}
+
+// Removes the last UTF-8 code point from a string
+static auto popCodePoint(std::string &s) -> void {
+    while (!s.empty() && (s.back() & 0xC0) == 0x80) {
+        s.pop_back();
+    }
+    if (!s.empty()) {
+        s.pop_back();
+    }
+}
+
+// Returns the index after the closing char of a group or a class starting at i
+static auto skipGroup(std::string_view pattern, size_t i) -> size_t {
+    auto depth = 0;
+    auto inClass = false;
+    while (i < pattern.size()) {
+        auto c = pattern[i];
+        if (c == '\\') {
+            i += 2;
+            continue;
+        }
+        if (inClass) {
+            if (c == '[' && i + 1 < pattern.size() && pattern[i + 1] == ':') {
+                auto close = pattern.find(":]", i + 2);
+                i = close == std::string_view::npos ? pattern.size() : close + 2;
+                continue;
+            }
+            if (c == ']') {
+                inClass = false;
+            }
+        } else if (c == '[') {
+            inClass = true;
+            if (i + 1 < pattern.size() && pattern[i + 1] == '^') {
+                i++;
+            }
+            if (i + 1 < pattern.size() && pattern[i + 1] == ']') {
+                i++;
+            }
+        } else if (c == '(') {
+            depth++;
+        } else if (c == ')') {
+            depth--;
+            if (depth <= 0) {
+                return i + 1;
+            }
+        }
+        if (!inClass && depth == 0) {
+            return i + 1;
+        }
+        i++;
+    }
+    return pattern.size();
+}
+
+// Parses "{n}", "{n,}" or "{n,m}". Returns false if this is not a quantifier.
+static auto parseQuantifier(std::string_view pattern, size_t i, size_t &end, int &minimum)
+    -> bool {
+    auto close = pattern.find('}', i);
+    if (close == std::string_view::npos || close == i + 1) {
+        return false;
+    }
+    auto body = pattern.substr(i + 1, close - i - 1);
+    if (!std::isdigit(static_cast<unsigned char>(body[0]))) {
+        return false;
+    }
+    for (auto c : body) {
+        if (!std::isdigit(static_cast<unsigned char>(c)) && c != ',') {
+            return false;
+        }
+    }
+    minimum = std::atoi(std::string(body).c_str());
+    end = close + 1;
+    return true;
+}
+
+/**
+ * Returns the longest literal which every match of the pattern must contain, or
+ * an empty string if none could be found. This is conservative: anything which is
+ * not understood ends the current literal run, and constructs which change how the
+ * rest of the pattern is parsed (top level alternation, inline options, quoting)
+ * disable the extraction altogether.
+ */
+auto SearchMatcher::requiredLiteral(std::string_view pattern) -> std::string {
+    for (auto p = pattern.find("(?"); p != std::string_view::npos;
+         p = pattern.find("(?", p + 1)) {
+        if (p + 2 >= pattern.size() || pattern[p + 2] != ':') {
+            return {};
+        }
+    }
+    if (pattern.find("\\Q") != std::string_view::npos) {
+        return {};
+    }
+
+    auto best = std::string();
+    auto current = std::string();
+    auto flush = [&]() {
+        if (current.size() > best.size()) {
+            best = current;
+        }
+        current.clear();
+    };
+    auto skipLazySuffix = [&](size_t i) {
+        if (i < pattern.size() && (pattern[i] == '?' || pattern[i] == '+')) {
+            i++;
+        }
+        return i;
+    };
+
+    auto i = size_t(0);
+    while (i < pattern.size()) {
+        auto c = pattern[i];
+        switch (c) {
+        case '\\': {
+            if (i + 1 >= pattern.size()) {
+                return {};
+            }
+            auto e = pattern[i + 1];
+            i += 2;
+            if (std::isalnum(static_cast<unsigned char>(e))) {
+                // classes, anchors, back references, code points - none is a literal
+                flush();
+                if (i < pattern.size() && (pattern[i] == '{' || pattern[i] == '<')) {
+                    auto close = pattern.find(pattern[i] == '{' ? '}' : '>', i);
+                    i = close == std::string_view::npos ? pattern.size() : close + 1;
+                }
+                continue;
+            }
+            current += e;
+            continue;
+        }
+        case '[':
+        case '(':
+            flush();
+            i = skipGroup(pattern, i);
+            continue;
+        case ')':
+        case '|':
+            return {};
+        case '.':
+        case '^':
+        case '$':
+            flush();
+            i++;
+            continue;
+        case '*':
+        case '?':
+            popCodePoint(current);
+            flush();
+            i = skipLazySuffix(i + 1);
+            continue;
+        case '+':
+            flush();
+            i = skipLazySuffix(i + 1);
+            continue;
+        case '{': {
+            auto end = size_t(0);
+            auto minimum = 0;
+            if (parseQuantifier(pattern, i, end, minimum)) {
+                if (minimum == 0) {
+                    popCodePoint(current);
+                }
+                flush();
+                i = skipLazySuffix(end);
+                continue;
+            }
+            current += c;
+            i++;
+            continue;
+        }
+        default:
+            current += c;
+            i++;
+        }
+    }
+    flush();
+    return best;
+}
+
+SearchMatcher::SearchMatcher(const std::string &searchText, SearchOptions options)
+    : searchText(searchText), options(options) {
+    literalOnly = !options.useRegex && !options.wholeWord &&
+                  (options.caseSensitive || isAscii(searchText));
+    if (literalOnly) {
+        literal = StringFinder(searchText, options.caseSensitive);
+        return;
+    }
+
+    auto literalText = options.useRegex ? requiredLiteral(searchText) : searchText;
+    if (!options.caseSensitive) {
+        literalText = longestCaselessRun(literalText);
+    }
+    literal = StringFinder(literalText, options.caseSensitive);
+
+    regex = makeRegex(searchText, options);
+    regex.optimize();
+}
+
+auto SearchMatcher::makeRegex(const std::string &searchText, SearchOptions options)
+    -> QRegularExpression {
+    auto text = QString::fromStdString(searchText);
+    auto pattern = QString();
+    if (options.useRegex) {
+        pattern = text;
+    } else {
+        pattern = QRegularExpression::escape(text);
+        if (options.wholeWord) {
+            pattern = "\\b" + pattern + "\\b";
+        }
+    }
+
+    auto patternOptions = QRegularExpression::PatternOptions();
+    if (!options.caseSensitive) {
+        patternOptions |= QRegularExpression::CaseInsensitiveOption;
+    }
+    if (options.useRegex && options.multiline) {
+        // ^ and $ still match at the start and end of each line
+        patternOptions |= QRegularExpression::MultilineOption;
+    }
+    return QRegularExpression(pattern, patternOptions);
+}
+
+auto SearchMatcher::errorString() const -> QString {
+    if (isValid()) {
+        return {};
+    }
+    return QString("%1 (offset %2)").arg(regex.errorString()).arg(regex.patternErrorOffset());
+}
+
+auto SearchMatcher::matches(QStringView line) const -> bool {
+    return regex.matchView(line).hasMatch();
+}
+
+auto SearchMatcher::matchesLine(std::string_view line) const -> bool {
+    if (!literal.isEmpty() && literal.find(line) == std::string_view::npos) {
+        return false;
+    }
+    return literalOnly || matches(QString::fromUtf8(line.data(), line.size()));
+}
@@ -0,0 +1,65 @@
+/**
+ * \file SearchMatcher.h
+ * \brief Definition of the compiled project search query
+ * \author Diego Iastrubni (diegoiast@gmail.com)
+ *  License MIT
+ */
+
+#pragma once
+
+#include <string>
+#include <string_view>
+
+#include <QRegularExpression>
+#include <QString>
+
+#include "StringFinder.h"
+
+struct SearchOptions {
+    bool caseSensitive = false;
+    bool wholeWord = false;
+    bool useRegex = false;
+    bool searchInBinaries = false;
+    // Regular expressions run on the whole file, and a match may span lines
+    bool multiline = false;
+};
+
+/**
+ * A search query, compiled once per search.
+ *
+ * Plain text queries are handled by a StringFinder alone. Anything else is matched with a
+ * JIT compiled QRegularExpression, but a literal which every match must contain is extracted
+ * from the pattern first. That literal is scanned over the raw file buffer, and the regex
+ * only runs on lines which contain it.
+ *
+ * In multiline mode the regex runs on the whole file instead, and the literal only decides
+ * if the file is worth decoding at all.
+ */
+class SearchMatcher {
+  public:
+    SearchMatcher(const std::string &searchText, SearchOptions options);
+
+    auto isValid() const -> bool { return literalOnly || regex.isValid(); }
+    auto errorString() const -> QString;
+    auto isLiteralOnly() const -> bool { return literalOnly; }
+    auto isMultiline() const -> bool { return options.multiline && options.useRegex; }
+    auto getLiteral() const -> const StringFinder & { return literal; }
+    auto getSearchText() const -> const std::string & { return searchText; }
+    auto getOptions() const -> SearchOptions { return options; }
+    auto getRegex() const -> const QRegularExpression & { return regex; }
+    auto matches(QStringView line) const -> bool;
+    // Matches a single UTF-8 line, without the new line
+    auto matchesLine(std::string_view line) const -> bool;
+
+    static auto requiredLiteral(std::string_view pattern) -> std::string;
+    // The query as a regular expression, whatever its options are
+    static auto makeRegex(const std::string &searchText, SearchOptions options)
+        -> QRegularExpression;
+
+  private:
+    std::string searchText;
+    SearchOptions options;
+    bool literalOnly = false;
+    StringFinder literal;
+    QRegularExpression regex;
+};
@@ -0,0 +1,97 @@
+/**
+ * \file SearchReplacer.cpp
+ * \brief Implementation of project wide replace over search results
+ * \author Diego Iastrubni (diegoiast@gmail.com)
+ *  License MIT
+ */
+
+#include <QByteArray>
+#include <QCoreApplication>
+#include <QFile>
+#include <QSaveFile>
+
+#include "SearchMatcher.h"
+#include "SearchReplacer.h"
+
+SearchReplacer::SearchReplacer(const std::string &searchText, SearchOptions options,
+                               const QString &replacement)
+    : regex(SearchMatcher::makeRegex(searchText, options)), replacement(replacement) {
+    // Back references only make sense for regular expressions
+    if (!options.useRegex) {
+        this->replacement.replace('\\', "\\\\");
+    }
+    regex.optimize();
+}
+
+auto SearchReplacer::replaceLine(QString &line) const -> size_t {
+    auto count = size_t(0);
+    for (auto it = regex.globalMatchView(line); it.hasNext(); it.next()) {
+        count++;
+    }
+    if (count != 0) {
+        line.replace(regex, replacement);
+    }
+    return count;
+}
+
+auto SearchReplacer::replaceInFile(const QString &fileName, const QList<FoundData> &lines) const
+    -> ReplaceFileResult {
+    auto result = ReplaceFileResult{fileName, 0, {}};
+    auto file = QFile(fileName);
+    if (!file.open(QIODevice::ReadOnly)) {
+        result.error = file.errorString();
+        return result;
+    }
+    auto const content = file.readAll();
+    file.close();
+
+    auto output = QByteArray();
+    output.reserve(content.size() + content.size() / 8);
+    auto next = lines.cbegin();
+    auto start = qsizetype(0);
+    auto lineNumber = size_t(0);
+    while (next != lines.cend() && start < content.size()) {
+        auto end = content.indexOf('\n', start);
+        if (end < 0) {
+            end = content.size();
+        }
+        auto line = QByteArrayView(content).sliced(start, end - start);
+        if (lineNumber == next->lineNumber) {
+            if (line.compare(QByteArrayView(next->line.data(), next->line.size())) != 0) {
+                break;
+            }
+            auto text = QString::fromUtf8(line);
+            result.replaced += replaceLine(text);
+            output.append(text.toUtf8());
+            ++next;
+        } else {
+            output.append(line);
+        }
+        if (end < content.size()) {
+            output += '\n';
+        }
+        start = end + 1;
+        lineNumber++;
+    }
+    if (next != lines.cend()) {
+        result.replaced = 0;
+        result.error = QCoreApplication::translate("SearchReplacer",
+                                                   "The file was modified since it was searched");
+        return result;
+    }
+    if (result.replaced == 0) {
+        return result;
+    }
+    if (start < content.size()) {
+        output.append(QByteArrayView(content).sliced(start));
+    }
+
+    // QSaveFile writes to a temporary file, and only renames it over the original on commit
+    auto saveFile = QSaveFile(fileName);
+    if (!saveFile.open(QIODevice::WriteOnly) || saveFile.write(output) != output.size() ||
+        !saveFile.commit()) {
+        result.replaced = 0;
+        result.error = saveFile.errorString();
+    }
+    return result;
+}
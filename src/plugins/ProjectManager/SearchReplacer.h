@@ -0,0 +1,50 @@
+/**
+ * \file SearchReplacer.h
+ * \brief Definition of project wide replace over search results
+ * \author Diego Iastrubni (diegoiast@gmail.com)
+ *  License MIT
+ */
+
+#pragma once
+
+#include <string>
+
+#include <QList>
+#include <QRegularExpression>
+#include <QString>
+
+#include "SearchEngine.h"
+
+struct ReplaceFileResult {
+    QString fileName;
+    size_t replaced = 0;
+    // Empty on success
+    QString error;
+};
+
+/**
+ * Replaces the matches of a search query, in the lines a search found.
+ *
+ * Files are rewritten only if each of these lines is still the same as when it was found,
+ * otherwise the file is left alone, since the line numbers can no longer be trusted. New
+ * content goes to a temporary file next to the original one, which is then renamed over
+ * it, so a failure never leaves a file half written.
+ *
+ * All methods are const and can be called from several threads at once.
+ */
+class SearchReplacer {
+  public:
+    SearchReplacer(const std::string &searchText, SearchOptions options,
+                   const QString &replacement);
+
+    auto isValid() const -> bool { return regex.isValid(); }
+
+    // Replaces all matches in the line, returns how many were replaced
+    auto replaceLine(QString &line) const -> size_t;
+    auto replaceInFile(const QString &fileName, const QList<FoundData> &lines) const
+        -> ReplaceFileResult;
+
+  private:
+    QRegularExpression regex;
+    QString replacement;
+};
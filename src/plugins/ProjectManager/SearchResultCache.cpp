@@ -0,0 +1,60 @@
+/**
+ * \file SearchResultCache.cpp
+ * \brief Implementation of the cache of recent project search results
+ * \author Diego Iastrubni (diegoiast@gmail.com)
+ *  License MIT
+ */
+
+#include <QDir>
+
+#include "SearchResultCache.h"
+
+auto SearchResultCache::makeKey(const SearchRequest &request) -> QString {
+    auto const &options = request.options;
+    auto flags = QString("%1%2%3%4%5%6")
+                     .arg(options.caseSensitive ? 'c' : '-')
+                     .arg(options.wholeWord ? 'w' : '-')
+                     .arg(options.useRegex ? 'r' : '-')
+                     .arg(options.searchInBinaries ? 'b' : '-')
+                     .arg(options.multiline ? 'm' : '-')
+                     .arg(request.useIgnoreFiles ? 'i' : '-');
+    // Fields are separated by a char which cannot be typed into any of them
+    auto const separator = QChar(0);
+    return QDir::cleanPath(request.startPath) + separator + flags + separator +
+           request.includeList + separator + request.excludeList + separator +
+           QString::fromStdString(request.searchText);
+}
+
+auto SearchResultCache::find(const QString &key) -> std::shared_ptr<const Entry> {
+    auto lock = std::unique_lock(mutex);
+    for (auto it = entries.begin(); it != entries.end(); ++it) {
+        if (it->first == key) {
+            entries.splice(entries.begin(), entries, it);
+            return entries.front().second;
+        }
+    }
+    return {};
+}
+
+auto SearchResultCache::store(const QString &key, std::shared_ptr<const Entry> entry) -> void {
+    auto lock = std::unique_lock(mutex);
+    entries.remove_if([&key](auto const &e) { return e.first == key; });
+    if (entry->size() > MaxFiles) {
+        return;
+    }
+    entries.emplace_front(key, std::move(entry));
+
+    auto files = size_t(0);
+    for (auto const &e : entries) {
+        files += e.second->size();
+    }
+    while (entries.size() > MaxEntries || files > MaxFiles) {
+        files -= entries.back().second->size();
+        entries.pop_back();
+    }
+}
+
+auto SearchResultCache::clear() -> void {
+    auto lock = std::unique_lock(mutex);
+    entries.clear();
+}
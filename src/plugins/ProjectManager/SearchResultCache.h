@@ -0,0 +1,51 @@
+/**
+ * \file SearchResultCache.h
+ * \brief Definition of the cache of recent project search results
+ * \author Diego Iastrubni (diegoiast@gmail.com)
+ *  License MIT
+ */
+
+#pragma once
+
+#include <list>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+#include <QString>
+
+#include "SearchEngine.h"
+
+/**
+ * Remembers the files searched by the last few searches, in the order they were reported.
+ *
+ * A search with the same query, options, file lists and root starts from the cached files:
+ * each one is checked with a single stat(), and only files which changed size or
+ * modification time are searched again. The directory is then walked as usual, to pick up
+ * new files.
+ *
+ * Every searched file is kept, matching or not, so the entries are bounded by their total
+ * number of files as well: the least recently used ones are dropped first, and searches of
+ * more than MaxFiles files are not cached at all.
+ *
+ * Entries are immutable once stored, so searches can share them without locking. Thread safe.
+ */
+class SearchResultCache {
+  public:
+    using Entry = std::vector<CachedSearchFile>;
+
+    static constexpr size_t MaxEntries = 8;
+    static constexpr size_t MaxFiles = 100000;
+
+    static auto makeKey(const SearchRequest &request) -> QString;
+
+    auto find(const QString &key) -> std::shared_ptr<const Entry>;
+    auto store(const QString &key, std::shared_ptr<const Entry> entry) -> void;
+    auto clear() -> void;
+
+  private:
+    std::mutex mutex;
+    // Most recently used first
+    std::list<std::pair<QString, std::shared_ptr<const Entry>>> entries;
+};
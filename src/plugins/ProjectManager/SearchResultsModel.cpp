@@ -0,0 +1,251 @@
+/**
+ * \file SearchResultsModel.cpp
+ * \brief Implementation of the model holding project search results
+ * \author Diego Iastrubni (diegoiast@gmail.com)
+ *  License MIT
+ */
+
+#include <algorithm>
+
+#include <QTimer>
+
+#include "SearchReplacer.h"
+#include "SearchResultsModel.h"
+
+// ~30 updates per second
+static constexpr auto FlushInterval = 33;
+static constexpr auto MaxDisplayedLineLength = size_t(256);
+
+// A multiline match is shown in a single row, with a mark where each of its lines ends
+static auto displayText(const QString &text) -> QString {
+    if (!text.contains('\n')) {
+        return text.trimmed();
+    }
+    auto lines = text.split('\n');
+    for (auto &line : lines) {
+        line = line.trimmed();
+    }
+    return lines.join(QString(" \u21b5 "));
+}
+
+SearchResultsModel::SearchResultsModel(QObject *parent) : QAbstractItemModel(parent) {
+    flushTimer = new QTimer(this);
+    flushTimer->setInterval(FlushInterval);
+    connect(flushTimer, &QTimer::timeout, this, &SearchResultsModel::flush);
+}
+
+SearchResultsModel::~SearchResultsModel() {}
+
+auto SearchResultsModel::beginSearch() -> size_t {
+    clear();
+    searchId++;
+    {
+        auto lock = std::unique_lock(pendingMutex);
+        pendingSearchId = searchId;
+        pending.clear();
+    }
+    flushTimer->start();
+    return searchId;
+}
+
+auto SearchResultsModel::endSearch(size_t searchId) -> void {
+    if (searchId != this->searchId) {
+        return;
+    }
+    flush();
+    flushTimer->stop();
+}
+
+auto SearchResultsModel::clear() -> void {
+    beginResetModel();
+    files.clear();
+    matchCount = 0;
+    truncated = false;
+    endResetModel();
+    emit headerDataChanged(Qt::Horizontal, 0, 0);
+}
+
+auto SearchResultsModel::narrowSearch(const std::function<bool(const FoundData &)> &keep)
+    -> size_t {
+    flushTimer->stop();
+    searchId++;
+    {
+        auto lock = std::unique_lock(pendingMutex);
+        pendingSearchId = searchId;
+        pending.clear();
+    }
+
+    beginResetModel();
+    matchCount = 0;
+    std::erase_if(files, [this, &keep](FileResults &file) {
+        file.found.removeIf([&keep](const FoundData &found) { return !keep(found); });
+        matchCount += file.found.size();
+        return file.found.isEmpty();
+    });
+    truncated = false;
+    endResetModel();
+    emit headerDataChanged(Qt::Horizontal, 0, 0);
+    if (!files.empty()) {
+        emit filesAdded(0, static_cast<int>(files.size()) - 1);
+    }
+    return searchId;
+}
+
+auto SearchResultsModel::setReplacePreview(std::shared_ptr<const SearchReplacer> replacer)
+    -> void {
+    emit layoutAboutToBeChanged();
+    replacePreview = std::move(replacer);
+    emit layoutChanged();
+    emit headerDataChanged(Qt::Horizontal, 0, 0);
+}
+
+auto SearchResultsModel::queueResult(size_t searchId, SearchFileResult &&result) -> void {
+    auto lock = std::unique_lock(pendingMutex);
+    if (searchId != pendingSearchId) {
+        return;
+    }
+    pending.push_back(std::move(result));
+}
+
+auto SearchResultsModel::flush() -> void {
+    auto batch = std::vector<SearchFileResult>();
+    {
+        auto lock = std::unique_lock(pendingMutex);
+        batch.swap(pending);
+    }
+    if (batch.empty() || truncated) {
+        return;
+    }
+
+    auto added = std::vector<FileResults>();
+    added.reserve(batch.size());
+    for (auto &result : batch) {
+        if (maxMatches != 0) {
+            auto remaining = maxMatches - matchCount;
+            if (static_cast<size_t>(result.found.size()) >= remaining) {
+                result.found.resize(remaining);
+                truncated = true;
+            }
+        }
+        if (!result.found.isEmpty()) {
+            matchCount += result.found.size();
+            added.push_back({std::move(result.fullFileName), std::move(result.shortFileName),
+                             std::move(result.found)});
+        }
+        if (truncated) {
+            break;
+        }
+    }
+
+    if (!added.empty()) {
+        auto first = static_cast<int>(files.size());
+        auto last = first + static_cast<int>(added.size()) - 1;
+        beginInsertRows({}, first, last);
+        std::move(added.begin(), added.end(), std::back_inserter(files));
+        endInsertRows();
+        emit filesAdded(first, last);
+    }
+
+    if (truncated) {
+        emit headerDataChanged(Qt::Horizontal, 0, 0);
+        emit matchLimitReached();
+    }
+}
+
+QModelIndex SearchResultsModel::index(int row, int column, const QModelIndex &parent) const {
+    if (row < 0 || column < 0 || column >= columnCount()) {
+        return {};
+    }
+    if (!parent.isValid()) {
+        if (static_cast<size_t>(row) >= files.size()) {
+            return {};
+        }
+        return createIndex(row, column, quintptr(0));
+    }
+    if (parent.internalId() != 0 || row >= files[parent.row()].found.size()) {
+        return {};
+    }
+    // Lines store their file's row + 1, so 0 can mark the files themselves
+    return createIndex(row, column, quintptr(parent.row() + 1));
+}
+
+QModelIndex SearchResultsModel::parent(const QModelIndex &index) const {
+    if (!index.isValid() || index.internalId() == 0) {
+        return {};
+    }
+    return createIndex(static_cast<int>(index.internalId() - 1), 0, quintptr(0));
+}
+
+int SearchResultsModel::rowCount(const QModelIndex &parent) const {
+    if (!parent.isValid()) {
+        return static_cast<int>(files.size());
+    }
+    if (parent.internalId() == 0 && parent.column() == 0) {
+        return static_cast<int>(files[parent.row()].found.size());
+    }
+    return 0;
+}
+
+int SearchResultsModel::columnCount(const QModelIndex &) const { return 2; }
+
+QVariant SearchResultsModel::data(const QModelIndex &index, int role) const {
+    if (!index.isValid()) {
+        return {};
+    }
+
+    if (index.internalId() == 0) {
+        auto const &file = files[index.row()];
+        switch (role) {
+        case Qt::DisplayRole:
+            return index.column() == 0 ? file.shortFileName : QVariant();
+        case Qt::ToolTipRole:
+        case FullFileNameRole:
+            return file.fullFileName;
+        }
+        return {};
+    }
+
+    auto const &file = files[index.internalId() - 1];
+    auto const &found = file.found[index.row()];
+    switch (role) {
+    case Qt::DisplayRole:
+    case Qt::ToolTipRole:
+        if (index.column() == 0) {
+            if (replacePreview && role == Qt::DisplayRole) {
+                auto line = QString::fromUtf8(found.line.data(), found.line.size());
+                replacePreview->replaceLine(line);
+                return displayText(line.left(MaxDisplayedLineLength));
+            }
+            auto length = std::min(found.line.size(), MaxDisplayedLineLength * found.lineCount);
+            auto text = QString::fromUtf8(found.line.data(), length);
+            return role == Qt::DisplayRole ? displayText(text) : text.trimmed();
+        }
+        if (role == Qt::ToolTipRole) {
+            return file.shortFileName;
+        }
+        if (found.lineCount > 1) {
+            auto lastLine = found.lineNumber + found.lineCount;
+            return QString("%1-%2").arg(found.lineNumber + 1).arg(lastLine);
+        }
+        return QString::number(found.lineNumber + 1);
+    case FullFileNameRole:
+        return file.fullFileName;
+    case LineNumberRole:
+        return static_cast<qulonglong>(found.lineNumber);
+    }
+    return {};
+}
+
+QVariant SearchResultsModel::headerData(int section, Qt::Orientation orientation,
+                                        int role) const {
+    if (orientation != Qt::Horizontal || role != Qt::DisplayRole) {
+        return {};
+    }
+    if (section == 0) {
+        if (replacePreview) {
+            return tr("Text (after replace)");
+        }
+        return truncated ? tr("Text (first %1 matches)").arg(matchCount) : tr("Text");
+    }
+    return tr("Line");
+}
@@ -0,0 +1,95 @@
+/**
+ * \file SearchResultsModel.h
+ * \brief Definition of the model holding project search results
+ * \author Diego Iastrubni (diegoiast@gmail.com)
+ *  License MIT
+ */
+
+#pragma once
+
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include <QAbstractItemModel>
+
+#include "SearchEngine.h"
+
+class QTimer;
+class SearchReplacer;
+
+/**
+ * A two level model: files, and the matching lines of each file.
+ *
+ * Results arrive from the search threads through queueResult(), and are appended to the
+ * model in batches, at most ~30 times a second. Rows are not objects, the model just indexes
+ * into the stored results, and display text is only decoded and trimmed when a view asks
+ * for it.
+ *
+ * Each search gets an id from beginSearch(). Results and notifications carrying an older
+ * id are ignored, so a finishing search cannot leak into the next one.
+ */
+class SearchResultsModel : public QAbstractItemModel {
+    Q_OBJECT
+
+  public:
+    enum Roles { FullFileNameRole = Qt::UserRole + 1, LineNumberRole };
+
+    struct FileResults {
+        QString fullFileName;
+        QString shortFileName;
+        QList<FoundData> found;
+    };
+
+    explicit SearchResultsModel(QObject *parent = nullptr);
+    ~SearchResultsModel();
+
+    // 0 means no limit
+    auto setMaxMatches(size_t max) -> void { maxMatches = max; }
+    auto getMaxMatches() const -> size_t { return maxMatches; }
+    auto getMatchCount() const -> size_t { return matchCount; }
+    auto isTruncated() const -> bool { return truncated; }
+
+    auto beginSearch() -> size_t;
+    auto endSearch(size_t searchId) -> void;
+    auto currentSearch() const -> size_t { return searchId; }
+    auto clear() -> void;
+    // Starts a search which keeps only the current lines accepted by `keep`, without
+    // searching again. Returns the new search id, the search is already ended.
+    auto narrowSearch(const std::function<bool(const FoundData &)> &keep) -> size_t;
+
+    auto getFiles() const -> const std::vector<FileResults> & { return files; }
+    // While set, lines are displayed as they would look after the replace
+    auto setReplacePreview(std::shared_ptr<const SearchReplacer> replacer) -> void;
+
+    // Thread safe
+    auto queueResult(size_t searchId, SearchFileResult &&result) -> void;
+
+    QModelIndex index(int row, int column, const QModelIndex &parent = {}) const override;
+    QModelIndex parent(const QModelIndex &index) const override;
+    int rowCount(const QModelIndex &parent = {}) const override;
+    int columnCount(const QModelIndex &parent = {}) const override;
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
+    QVariant headerData(int section, Qt::Orientation orientation,
+                        int role = Qt::DisplayRole) const override;
+
+  signals:
+    void filesAdded(int first, int last);
+    void matchLimitReached();
+
+  private:
+    auto flush() -> void;
+
+    std::vector<FileResults> files;
+    size_t matchCount = 0;
+    size_t maxMatches = 0;
+    bool truncated = false;
+    size_t searchId = 0;
+    std::shared_ptr<const SearchReplacer> replacePreview;
+    QTimer *flushTimer;
+
+    std::mutex pendingMutex;
+    size_t pendingSearchId = 0;
+    std::vector<SearchFileResult> pending;
+};
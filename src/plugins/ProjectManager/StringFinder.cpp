@@ -0,0 +1,222 @@
+/**
+ * \file StringFinder.cpp
+ * \brief Implementation of a fast literal substring finder
+ * \author Diego Iastrubni (diegoiast@gmail.com)
+ *  License MIT
+ */
+
+#include <array>
+#include <bit>
+#include <cstdint>
+#include <cstring>
+
+#include "StringFinder.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define STRING_FINDER_SSE2
+#include <emmintrin.h>
+#endif
+
+#if defined(STRING_FINDER_SSE2) && (defined(__GNUC__) || defined(__clang__))
+#define STRING_FINDER_AVX2
+#include <immintrin.h>
+#endif
+
+// Higher value means the byte is more common in source code. Bytes not listed
+// (control characters, most of the high half) are considered rare.
+static auto byteFrequencyTable() -> const std::array<uint8_t, 256> & {
+    static const auto table = []() {
+        auto t = std::array<uint8_t, 256>{};
+        const char *common = " etaoinsrlcdhupmfgy_bw.(),;v=k\n*x-/\"\t{}0:1TSEACRIN>LD<'"
+                             "2PO&FM[]BU#+3G!58HV4967W|%KYxjqzXQJZ\\@?$^~`\r";
+        auto rank = uint8_t(255);
+        for (auto p = common; *p; p++) {
+            auto &v = t[static_cast<uint8_t>(*p)];
+            if (v == 0) {
+                v = rank--;
+            }
+        }
+        return t;
+    }();
+    return table;
+}
+
+static auto toLowerAscii(char c) -> char { return (c >= 'A' && c <= 'Z') ? c + ('a' - 'A') : c; }
+
+static auto toUpperAscii(char c) -> char { return (c >= 'a' && c <= 'z') ? c - ('a' - 'A') : c; }
+
+static auto otherCase(char c, bool caseSensitive) -> char {
+    return caseSensitive ? c : toUpperAscii(c);
+}
+
+static auto verify(const char *haystack, std::string_view needle, bool caseSensitive) -> bool {
+    if (caseSensitive) {
+        return std::memcmp(haystack, needle.data(), needle.size()) == 0;
+    }
+    for (auto i = size_t(0); i < needle.size(); i++) {
+        if (toLowerAscii(haystack[i]) != needle[i]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static auto findScalar(std::string_view haystack, size_t from, std::string_view needle,
+                       size_t offset, bool caseSensitive) -> size_t {
+    auto const last = haystack.size() - needle.size();
+    auto const data = haystack.data();
+
+    if (!caseSensitive) {
+        auto const lower = needle[offset];
+        auto const upper = toUpperAscii(lower);
+        for (auto p = from; p <= last; p++) {
+            auto c = data[p + offset];
+            if ((c == lower || c == upper) && verify(data + p, needle, false)) {
+                return p;
+            }
+        }
+        return std::string_view::npos;
+    }
+
+    auto const c = needle[offset];
+    auto p = from;
+    while (p <= last) {
+        auto candidate =
+            static_cast<const char *>(std::memchr(data + p + offset, c, last - p + 1));
+        if (!candidate) {
+            return std::string_view::npos;
+        }
+        auto pos = static_cast<size_t>(candidate - data) - offset;
+        if (verify(data + pos, needle, true)) {
+            return pos;
+        }
+        p = pos + 1;
+    }
+    return std::string_view::npos;
+}
+
+#if defined(STRING_FINDER_SSE2)
+static auto findSSE2(std::string_view haystack, size_t &from, std::string_view needle,
+                     size_t offset1, size_t offset2, bool caseSensitive) -> size_t {
+    auto const data = haystack.data();
+    auto const last = haystack.size() - needle.size();
+    auto const lower1 = _mm_set1_epi8(needle[offset1]);
+    auto const upper1 = _mm_set1_epi8(otherCase(needle[offset1], caseSensitive));
+    auto const lower2 = _mm_set1_epi8(needle[offset2]);
+    auto const upper2 = _mm_set1_epi8(otherCase(needle[offset2], caseSensitive));
+    auto p = from;
+
+    while (p + 15 <= last) {
+        auto b1 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + p + offset1));
+        auto b2 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + p + offset2));
+        auto eq1 = _mm_or_si128(_mm_cmpeq_epi8(b1, lower1), _mm_cmpeq_epi8(b1, upper1));
+        auto eq2 = _mm_or_si128(_mm_cmpeq_epi8(b2, lower2), _mm_cmpeq_epi8(b2, upper2));
+        auto mask = static_cast<uint32_t>(_mm_movemask_epi8(_mm_and_si128(eq1, eq2)));
+        while (mask != 0) {
+            auto pos = p + std::countr_zero(mask);
+            if (verify(data + pos, needle, caseSensitive)) {
+                return pos;
+            }
+            mask &= mask - 1;
+        }
+        p += 16;
+    }
+    from = p;
+    return std::string_view::npos;
+}
+#endif
+
+#if defined(STRING_FINDER_AVX2)
+__attribute__((target("avx2"))) static auto findAVX2(std::string_view haystack, size_t &from,
+                                                     std::string_view needle, size_t offset1,
+                                                     size_t offset2, bool caseSensitive)
+    -> size_t {
+    auto const data = haystack.data();
+    auto const last = haystack.size() - needle.size();
+    auto const lower1 = _mm256_set1_epi8(needle[offset1]);
+    auto const upper1 = _mm256_set1_epi8(otherCase(needle[offset1], caseSensitive));
+    auto const lower2 = _mm256_set1_epi8(needle[offset2]);
+    auto const upper2 = _mm256_set1_epi8(otherCase(needle[offset2], caseSensitive));
+    auto p = from;
+
+    while (p + 31 <= last) {
+        auto b1 = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(data + p + offset1));
+        auto b2 = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(data + p + offset2));
+        auto eq1 = _mm256_or_si256(_mm256_cmpeq_epi8(b1, lower1), _mm256_cmpeq_epi8(b1, upper1));
+        auto eq2 = _mm256_or_si256(_mm256_cmpeq_epi8(b2, lower2), _mm256_cmpeq_epi8(b2, upper2));
+        auto mask = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_and_si256(eq1, eq2)));
+        while (mask != 0) {
+            auto pos = p + std::countr_zero(mask);
+            if (verify(data + pos, needle, caseSensitive)) {
+                return pos;
+            }
+            mask &= mask - 1;
+        }
+        p += 32;
+    }
+    from = p;
+    return std::string_view::npos;
+}
+
+static auto hasAVX2() -> bool {
+    static const auto supported = __builtin_cpu_supports("avx2") != 0;
+    return supported;
+}
+#endif
+
+StringFinder::StringFinder(std::string_view needle, bool caseSensitive)
+    : pattern(needle), caseSensitive(caseSensitive) {
+    if (!caseSensitive) {
+        for (auto &c : pattern) {
+            c = toLowerAscii(c);
+        }
+    }
+    if (pattern.size() < 2) {
+        return;
+    }
+
+    // Pick the two rarest bytes, at different offsets.
+    auto const &frequency = byteFrequencyTable();
+    auto rank = [&](size_t i) { return frequency[static_cast<uint8_t>(pattern[i])]; };
+    rareOffset1 = 0;
+    for (auto i = size_t(1); i < pattern.size(); i++) {
+        if (rank(i) < rank(rareOffset1)) {
+            rareOffset1 = i;
+        }
+    }
+    rareOffset2 = rareOffset1 == 0 ? 1 : 0;
+    for (auto i = size_t(0); i < pattern.size(); i++) {
+        if (i != rareOffset1 && rank(i) < rank(rareOffset2)) {
+            rareOffset2 = i;
+        }
+    }
+}
+
+auto StringFinder::find(std::string_view haystack, size_t from) const -> size_t {
+    if (pattern.empty()) {
+        return from <= haystack.size() ? from : std::string_view::npos;
+    }
+    if (haystack.size() < pattern.size() || from > haystack.size() - pattern.size()) {
+        return std::string_view::npos;
+    }
+    if (pattern.size() == 1 && caseSensitive) {
+        auto p = std::memchr(haystack.data() + from, pattern[0], haystack.size() - from);
+        return p ? static_cast<const char *>(p) - haystack.data() : std::string_view::npos;
+    }
+
+#if defined(STRING_FINDER_AVX2)
+    if (hasAVX2()) {
+        auto pos = findAVX2(haystack, from, pattern, rareOffset1, rareOffset2, caseSensitive);
+        if (pos != std::string_view::npos) {
+            return pos;
+        }
+    }
+#endif
+#if defined(STRING_FINDER_SSE2)
+    auto pos = findSSE2(haystack, from, pattern, rareOffset1, rareOffset2, caseSensitive);
+    if (pos != std::string_view::npos) {
+        return pos;
+    }
+#endif
+    return findScalar(haystack, from, pattern, rareOffset1, caseSensitive);
+}
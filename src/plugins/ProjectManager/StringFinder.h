@@ -0,0 +1,38 @@
+/**
+ * \file StringFinder.h
+ * \brief Definition of a fast literal substring finder
+ * \author Diego Iastrubni (diegoiast@gmail.com)
+ *  License MIT
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+/**
+ * Finds a literal needle inside a byte buffer.
+ *
+ * The two bytes of the needle which are least likely to appear in source code are
+ * chosen at construction time. The haystack is then scanned 16 or 32 bytes at a time
+ * (SSE2/AVX2) for positions where both bytes appear at their expected offsets, and
+ * only those candidates are verified with memcmp.
+ *
+ * When case insensitive, only ASCII letters are folded.
+ */
+class StringFinder {
+  public:
+    explicit StringFinder(std::string_view needle = {}, bool caseSensitive = true);
+
+    auto find(std::string_view haystack, size_t from = 0) const -> size_t;
+    auto needle() const -> std::string_view { return pattern; }
+    auto isEmpty() const -> bool { return pattern.empty(); }
+    auto isCaseSensitive() const -> bool { return caseSensitive; }
+
+  private:
+    std::string pattern;
+    bool caseSensitive = true;
+    size_t rareOffset1 = 0;
+    size_t rareOffset2 = 0;
+};
@@ -0,0 +1,483 @@
+/**
+ * \file TrigramIndex.cpp
+ * \brief Implementation of the per project trigram index used by project search
+ * \author Diego Iastrubni (diegoiast@gmail.com)
+ *  License MIT
+ */
+
+#include <algorithm>
+#include <limits>
+#include <mutex>
+#include <thread>
+#include <unordered_set>
+
+#include <QDataStream>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+
+#include "DirectoryWalker.hpp"
+#include "MappedFile.hpp"
+#include "TextClassifier.hpp"
+#include "TrigramIndex.h"
+
+static constexpr quint32 IndexMagic = 0x49525451; // "QTRI"
+static constexpr quint32 IndexVersion = 1;
+
+static auto foldAscii(uint8_t c) -> uint8_t {
+    return (c >= 'A' && c <= 'Z') ? c + ('a' - 'A') : c;
+}
+
+static auto trigramAt(const char *p) -> uint32_t {
+    return (uint32_t(foldAscii(p[0])) << 16) | (uint32_t(foldAscii(p[1])) << 8) |
+           uint32_t(foldAscii(p[2]));
+}
+
+// Collects the distinct trigrams of a buffer. A bit per possible trigram is kept per thread,
+// and only the bits which were set are cleared afterwards.
+static auto collectTrigrams(std::string_view buffer) -> std::vector<uint32_t> {
+    thread_local auto seen = std::vector<uint64_t>((1u << 24) / 64);
+    auto result = std::vector<uint32_t>();
+    if (buffer.size() < 3) {
+        return result;
+    }
+    auto const data = buffer.data();
+    for (auto i = size_t(0); i + 2 < buffer.size(); i++) {
+        auto t = trigramAt(data + i);
+        auto &word = seen[t / 64];
+        auto bit = uint64_t(1) << (t % 64);
+        if ((word & bit) == 0) {
+            word |= bit;
+            result.push_back(t);
+        }
+    }
+    for (auto t : result) {
+        seen[t / 64] &= ~(uint64_t(1) << (t % 64));
+    }
+    std::sort(result.begin(), result.end());
+    return result;
+}
+
+static auto writeVarint(QByteArray &out, uint32_t v) -> void {
+    while (v >= 0x80) {
+        out.append(char((v & 0x7f) | 0x80));
+        v >>= 7;
+    }
+    out.append(char(v));
+}
+
+static auto readVarint(const char *&p, const char *end, uint32_t &v) -> bool {
+    v = 0;
+    for (auto shift = 0; p < end && shift < 35; shift += 7) {
+        auto b = uint8_t(*p++);
+        v |= uint32_t(b & 0x7f) << shift;
+        if ((b & 0x80) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+TrigramIndex::TrigramIndex(const QString &rootDir)
+    : rootDir(QDir::cleanPath(QDir::fromNativeSeparators(rootDir))) {}
+
+auto TrigramIndex::setExcludedPaths(const QStringList &paths) -> void {
+    excludedPaths.clear();
+    for (auto const &path : paths) {
+        excludedPaths.append(QDir::cleanPath(QDir::fromNativeSeparators(path)));
+    }
+}
+
+auto TrigramIndex::getFileCount() const -> size_t {
+    auto lock = std::shared_lock(mutex);
+    return files.size() - deadCount;
+}
+
+auto TrigramIndex::getDirectories() const -> QStringList {
+    auto lock = std::shared_lock(mutex);
+    auto dirs = std::unordered_set<std::string_view>();
+    for (auto const &f : files) {
+        if (!f.alive) {
+            continue;
+        }
+        auto dir = std::string_view(f.path);
+        auto slash = dir.rfind('/');
+        while (slash != std::string_view::npos) {
+            dir = dir.substr(0, slash);
+            if (!dirs.insert(dir).second) {
+                break;
+            }
+            slash = dir.rfind('/');
+        }
+    }
+
+    auto result = QStringList{QString()};
+    for (auto d : dirs) {
+        result.append(QString::fromUtf8(d.data(), d.size()) + '/');
+    }
+    return result;
+}
+
+auto TrigramIndex::indexFile(const QString &fullFileName, FileEntry entry) const -> IndexedFile {
+    auto result = IndexedFile{std::move(entry), {}};
+    if (result.entry.size > MaxIndexedFileSize) {
+        result.entry.kind = FileKind::Large;
+        return result;
+    }
+
+    auto file = MappedFile();
+    if (!file.open(fullFileName.toStdString())) {
+        // Unreadable files are never candidates, as searching them would fail too
+        result.entry.kind = FileKind::Text;
+        return result;
+    }
+    if (!TextClassifier::isTextFile(fullFileName, file.lastModified(), file.view())) {
+        result.entry.kind = FileKind::Binary;
+        return result;
+    }
+    result.entry.kind = FileKind::Text;
+    result.trigrams = collectTrigrams(file.view());
+    return result;
+}
+
+auto TrigramIndex::merge(std::vector<IndexedFile> &indexed) -> void {
+    auto lock = std::unique_lock(mutex);
+    for (auto &f : indexed) {
+        auto it = fileIds.find(f.entry.path);
+        if (it != fileIds.end()) {
+            if (files[it->second].alive) {
+                files[it->second].alive = false;
+                deadCount++;
+            }
+        }
+        auto id = static_cast<uint32_t>(files.size());
+        fileIds[f.entry.path] = id;
+        for (auto t : f.trigrams) {
+            postings[t].push_back(id);
+        }
+        files.push_back(std::move(f.entry));
+    }
+    indexed.clear();
+}
+
+auto TrigramIndex::compact() -> void {
+    if (deadCount == 0) {
+        return;
+    }
+    auto constexpr Dead = std::numeric_limits<uint32_t>::max();
+    auto remap = std::vector<uint32_t>(files.size(), Dead);
+    auto alive = std::vector<FileEntry>();
+    alive.reserve(files.size() - deadCount);
+    fileIds.clear();
+    for (auto i = size_t(0); i < files.size(); i++) {
+        if (files[i].alive) {
+            remap[i] = static_cast<uint32_t>(alive.size());
+            fileIds[files[i].path] = remap[i];
+            alive.push_back(std::move(files[i]));
+        }
+    }
+    files = std::move(alive);
+    deadCount = 0;
+
+    for (auto it = postings.begin(); it != postings.end();) {
+        auto &list = it->second;
+        auto out = list.begin();
+        for (auto id : list) {
+            if (remap[id] != Dead) {
+                *out++ = remap[id];
+            }
+        }
+        list.erase(out, list.end());
+        if (list.empty()) {
+            it = postings.erase(it);
+        } else {
+            list.shrink_to_fit();
+            ++it;
+        }
+    }
+}
+
+auto TrigramIndex::update(const QStringList &directories) -> size_t {
+    auto roots = directories.isEmpty() ? QStringList{rootDir} : directories;
+    auto seen = std::unordered_set<std::string>();
+    auto prefixes = std::vector<std::string>();
+    auto work = std::vector<std::pair<QString, FileEntry>>();
+
+    for (auto const &root : std::as_const(roots)) {
+        auto cleanRoot = QDir::cleanPath(QDir::fromNativeSeparators(root));
+        if (cleanRoot != rootDir && !cleanRoot.startsWith(rootDir + '/')) {
+            continue;
+        }
+        auto excluded = QStringList();
+        auto isExcluded = false;
+        for (auto const &path : std::as_const(excludedPaths)) {
+            if (cleanRoot == path || cleanRoot.startsWith(path + '/')) {
+                isExcluded = true;
+            } else if (path.startsWith(cleanRoot + '/')) {
+                excluded.append(path.mid(cleanRoot.size() + 1));
+            }
+        }
+        if (isExcluded) {
+            continue;
+        }
+        if (cleanRoot == rootDir) {
+            prefixes.push_back({});
+        } else {
+            prefixes.push_back(cleanRoot.mid(rootDir.size() + 1).toStdString() + '/');
+        }
+
+        auto walker = DirectoryWalker(cleanRoot);
+        walker.setTopDir(rootDir);
+        walker.setExcludedPaths(excluded);
+        walker.walk([&](const QString &fullFileName, const QString &) {
+            auto info = QFileInfo(fullFileName);
+            auto entry = FileEntry();
+            entry.path = fullFileName.mid(rootDir.size() + 1).toStdString();
+            entry.size = static_cast<uint64_t>(info.size());
+            entry.mtime = info.lastModified().toMSecsSinceEpoch();
+            seen.insert(entry.path);
+
+            auto lock = std::shared_lock(mutex);
+            auto known = fileIds.find(entry.path);
+            if (known != fileIds.end()) {
+                auto const &current = files[known->second];
+                if (current.alive && current.size == entry.size && current.mtime == entry.mtime) {
+                    return !cancelRequested;
+                }
+            }
+            work.emplace_back(fullFileName, std::move(entry));
+            return !cancelRequested;
+        });
+    }
+    if (cancelRequested) {
+        return 0;
+    }
+
+    // Index in parallel, merging each batch as soon as it is done
+    auto constexpr batchSize = size_t(256);
+    auto nextBatch = std::atomic<size_t>(0);
+    auto threadCount = std::max(1u, std::thread::hardware_concurrency());
+    auto workers = std::vector<std::thread>();
+    for (auto i = 0u; i < threadCount; i++) {
+        workers.emplace_back([&]() {
+            auto indexed = std::vector<IndexedFile>();
+            while (!cancelRequested) {
+                auto start = nextBatch.fetch_add(batchSize);
+                if (start >= work.size()) {
+                    break;
+                }
+                auto end = std::min(start + batchSize, work.size());
+                for (auto j = start; j < end; j++) {
+                    indexed.push_back(indexFile(work[j].first, work[j].second));
+                }
+                merge(indexed);
+            }
+        });
+    }
+    for (auto &w : workers) {
+        w.join();
+    }
+    if (cancelRequested) {
+        return 0;
+    }
+
+    auto changes = work.size();
+    {
+        auto lock = std::unique_lock(mutex);
+        for (auto &f : files) {
+            if (!f.alive || seen.contains(f.path)) {
+                continue;
+            }
+            auto underRoot = std::any_of(prefixes.begin(), prefixes.end(), [&f](auto const &p) {
+                return std::string_view(f.path).starts_with(p);
+            });
+            if (underRoot) {
+                f.alive = false;
+                fileIds.erase(f.path);
+                deadCount++;
+                changes++;
+            }
+        }
+        if (deadCount > (files.size() - deadCount) / 2) {
+            compact();
+        }
+    }
+    ready = true;
+    return changes;
+}
+
+auto TrigramIndex::candidates(std::string_view literal, bool includeBinaries,
+                              const QString &startPath, std::vector<QString> &result) const
+    -> bool {
+    if (!ready || literal.size() < 3) {
+        return false;
+    }
+
+    auto cleanStart = QDir::cleanPath(QDir::fromNativeSeparators(startPath));
+    auto prefix = std::string();
+    if (cleanStart != rootDir) {
+        if (!cleanStart.startsWith(rootDir + '/')) {
+            return false;
+        }
+        prefix = cleanStart.mid(rootDir.size() + 1).toStdString() + '/';
+    }
+
+    auto wanted = std::vector<uint32_t>();
+    for (auto i = size_t(0); i + 2 < literal.size(); i++) {
+        wanted.push_back(trigramAt(literal.data() + i));
+    }
+    std::sort(wanted.begin(), wanted.end());
+    wanted.erase(std::unique(wanted.begin(), wanted.end()), wanted.end());
+
+    auto lock = std::shared_lock(mutex);
+    auto lists = std::vector<const std::vector<uint32_t> *>();
+    auto missing = false;
+    for (auto t : wanted) {
+        auto it = postings.find(t);
+        if (it == postings.end()) {
+            missing = true;
+            break;
+        }
+        lists.push_back(&it->second);
+    }
+
+    auto ids = std::vector<uint32_t>();
+    if (!missing) {
+        std::sort(lists.begin(), lists.end(),
+                  [](auto a, auto b) { return a->size() < b->size(); });
+        ids = *lists.front();
+        auto scratch = std::vector<uint32_t>();
+        for (auto i = size_t(1); i < lists.size() && !ids.empty(); i++) {
+            scratch.clear();
+            std::set_intersection(ids.begin(), ids.end(), lists[i]->begin(), lists[i]->end(),
+                                  std::back_inserter(scratch));
+            ids.swap(scratch);
+        }
+    }
+
+    // Files which were not indexed must always be searched
+    for (auto i = size_t(0); i < files.size(); i++) {
+        auto kind = files[i].kind;
+        if (kind == FileKind::Large || (includeBinaries && kind == FileKind::Binary)) {
+            ids.push_back(static_cast<uint32_t>(i));
+        }
+    }
+
+    auto paths = std::vector<std::string_view>();
+    for (auto id : ids) {
+        auto const &f = files[id];
+        if (f.alive && std::string_view(f.path).starts_with(prefix)) {
+            paths.push_back(f.path);
+        }
+    }
+    std::sort(paths.begin(), paths.end());
+    paths.erase(std::unique(paths.begin(), paths.end()), paths.end());
+
+    result.clear();
+    result.reserve(paths.size());
+    for (auto p : paths) {
+        result.push_back(
+            QDir::toNativeSeparators(rootDir + '/' + QString::fromUtf8(p.data(), p.size())));
+    }
+    return true;
+}
+
+auto TrigramIndex::save(const QString &fileName) -> bool {
+    {
+        auto lock = std::unique_lock(mutex);
+        compact();
+    }
+
+    auto file = QSaveFile(fileName);
+    if (!file.open(QIODevice::WriteOnly)) {
+        return false;
+    }
+
+    auto lock = std::shared_lock(mutex);
+    auto stream = QDataStream(&file);
+    stream << IndexMagic << IndexVersion << rootDir;
+    stream << quint32(files.size());
+    for (auto const &f : files) {
+        stream << QByteArray::fromStdString(f.path) << quint64(f.size) << qint64(f.mtime)
+               << quint8(f.kind);
+    }
+
+    stream << quint32(postings.size());
+    auto encoded = QByteArray();
+    for (auto const &[trigram, ids] : postings) {
+        encoded.clear();
+        auto previous = uint32_t(0);
+        for (auto id : ids) {
+            writeVarint(encoded, id - previous);
+            previous = id;
+        }
+        stream << quint32(trigram) << quint32(ids.size()) << encoded;
+    }
+    return stream.status() == QDataStream::Ok && file.commit();
+}
+
+auto TrigramIndex::load(const QString &fileName) -> bool {
+    auto file = QFile(fileName);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+
+    auto stream = QDataStream(&file);
+    auto magic = quint32();
+    auto version = quint32();
+    auto storedRoot = QString();
+    stream >> magic >> version >> storedRoot;
+    if (magic != IndexMagic || version != IndexVersion || storedRoot != rootDir) {
+        return false;
+    }
+
+    auto loadedFiles = std::vector<FileEntry>();
+    auto loadedIds = std::unordered_map<std::string, uint32_t>();
+    auto fileCount = quint32();
+    stream >> fileCount;
+    for (auto i = quint32(0); i < fileCount && stream.status() == QDataStream::Ok; i++) {
+        auto path = QByteArray();
+        auto size = quint64();
+        auto mtime = qint64();
+        auto kind = quint8();
+        stream >> path >> size >> mtime >> kind;
+        auto entry = FileEntry{path.toStdString(), size, mtime, FileKind(kind), true};
+        loadedIds[entry.path] = i;
+        loadedFiles.push_back(std::move(entry));
+    }
+
+    auto loadedPostings = std::unordered_map<uint32_t, std::vector<uint32_t>>();
+    auto trigramCount = quint32();
+    stream >> trigramCount;
+    auto encoded = QByteArray();
+    for (auto i = quint32(0); i < trigramCount && stream.status() == QDataStream::Ok; i++) {
+        auto trigram = quint32();
+        auto count = quint32();
+        stream >> trigram >> count >> encoded;
+
+        auto &ids = loadedPostings[trigram];
+        ids.reserve(count);
+        auto p = encoded.constData();
+        auto end = p + encoded.size();
+        auto id = uint32_t(0);
+        for (auto j = quint32(0); j < count; j++) {
+            auto delta = uint32_t(0);
+            if (!readVarint(p, end, delta) || id + delta >= fileCount) {
+                return false;
+            }
+            id += delta;
+            ids.push_back(id);
+        }
+    }
+    if (stream.status() != QDataStream::Ok) {
+        return false;
+    }
+
+    auto lock = std::unique_lock(mutex);
+    files = std::move(loadedFiles);
+    fileIds = std::move(loadedIds);
+    postings = std::move(loadedPostings);
+    deadCount = 0;
+    return true;
+}
@@ -0,0 +1,96 @@
+/**
+ * \file TrigramIndex.h
+ * \brief Definition of the per project trigram index used by project search
+ * \author Diego Iastrubni (diegoiast@gmail.com)
+ *  License MIT
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include <QString>
+#include <QStringList>
+
+/**
+ * Maps every 3 byte sequence found in the text files of a directory tree to the list of
+ * files containing it. Files ignored by .gitignore and .ignore files are not indexed.
+ *
+ * Trigrams are ASCII case folded, so the same index serves case sensitive and case
+ * insensitive searches. A query literal of 3 bytes or more narrows the search to the files
+ * which contain all of its trigrams; those files still have to be searched, the index only
+ * rules out files which cannot match.
+ *
+ * Updates never rewrite posting lists: a changed file gets a new id, and the old one is
+ * marked as dead. Dead ids are dropped when the index is compacted, before saving.
+ *
+ * All public methods are thread safe. Building and updating take an exclusive lock only
+ * while merging results, so queries can run while the index is being refreshed.
+ */
+class TrigramIndex {
+  public:
+    enum class FileKind : uint8_t { Text, Binary, Large };
+
+    static constexpr uint64_t MaxIndexedFileSize = 32 * 1024 * 1024;
+
+    explicit TrigramIndex(const QString &rootDir);
+
+    auto getRootDir() const -> const QString & { return rootDir; }
+    // Files and directories (full paths) which are never indexed, like the index file itself.
+    // Set before the first update.
+    auto setExcludedPaths(const QStringList &paths) -> void;
+    auto isReady() const -> bool { return ready; }
+    auto getFileCount() const -> size_t;
+    // The directories holding indexed files, relative to the root (empty or ending with '/')
+    auto getDirectories() const -> QStringList;
+
+    auto load(const QString &fileName) -> bool;
+    auto save(const QString &fileName) -> bool;
+
+    // Walks the directories (recursively), indexes new and modified files and forgets
+    // files which are gone. With no directories given, the whole tree is refreshed.
+    // Returns the number of files which were added, changed or removed.
+    auto update(const QStringList &directories = {}) -> size_t;
+    // Stops the current update, and any later one
+    auto cancel() -> void { cancelRequested = true; }
+
+    // Fills the full path of the files under startPath which may contain the literal.
+    // Returns false if the literal is too short for the index to help.
+    auto candidates(std::string_view literal, bool includeBinaries, const QString &startPath,
+                    std::vector<QString> &files) const -> bool;
+
+  private:
+    struct FileEntry {
+        std::string path;
+        uint64_t size = 0;
+        int64_t mtime = 0;
+        FileKind kind = FileKind::Text;
+        bool alive = true;
+    };
+
+    struct IndexedFile {
+        FileEntry entry;
+        std::vector<uint32_t> trigrams;
+    };
+
+    auto indexFile(const QString &fullFileName, FileEntry entry) const -> IndexedFile;
+    auto merge(std::vector<IndexedFile> &files) -> void;
+    auto compact() -> void;
+
+    QString rootDir;
+    QStringList excludedPaths;
+    std::atomic<bool> ready = false;
+    std::atomic<bool> cancelRequested = false;
+
+    mutable std::shared_mutex mutex;
+    std::vector<FileEntry> files;
+    std::unordered_map<std::string, uint32_t> fileIds;
+    std::unordered_map<uint32_t, std::vector<uint32_t>> postings;
+    size_t deadCount = 0;
+};
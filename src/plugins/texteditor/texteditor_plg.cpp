@@ -4,7 +4,7 @@
 #include <QApplication>
 #include <QChar>
 #include <QCoreApplication>
-#include <QFile>
+#include <QFileInfo>
 #include <QMainWindow>
 #include <QMessageBox>
 #include <QString>
@@ -17,8 +17,8 @@
 #include <qmdihost.h>
 #include <qmdiserver.h>
 
-#include "AnsiToHTML.hpp"
 #include "GlobalCommands.hpp"
+#include "TextClassifier.hpp"
 #include "texteditor_plg.h"
 #include "thememanager.h"
 #include "widgets/HistoryLineEdit.h"
@@ -438,23 +438,14 @@ int TextEditorPlugin::canOpenFile(const QString &fileName) {
         return 5;
     }
 
-    auto file = QFile(fileName);
-    if (file.open(QIODevice::ReadOnly | QIODevice::Text)) {
-        auto in = QTextStream(&file);
-        QString firstLines = in.readLine();
-        firstLines.append(in.readLine());
-        firstLines.append(in.readLine());
-        firstLines.append(in.readLine());
-        firstLines.append(in.readLine());
-        file.close();
-        if (isPlainText(firstLines)) {
-            return 5;
-        }
+    // New (or empty) files are edited as text
+    auto info = QFileInfo(fileName);
+    if (!info.exists() || info.size() == 0) {
+        return 5;
     }
-    if (file.size() == 0) {
+    if (TextClassifier::isTextFile(fileName)) {
         return 5;
     }
-
     return 1;
 }
 
@@ -6,7 +6,10 @@
 
 // SPDX-License-Identifier: MIT
 
+#include "DirectoryWatcher.hpp"
+#include "FileListCache.hpp"
 #include "FilesList.hpp"
+#include "GlobSet.hpp"
 #include "LoadingWidget.hpp"
 
 #include <QCoreApplication>
@@ -16,13 +19,15 @@
 #include <QFileInfo>
 #include <QLineEdit>
 #include <QListView>
-#include <QQueue>
-#include <QRegularExpression>
+#include <QScrollBar>
+#include <QSet>
 #include <QThread>
 #include <QThreadPool>
 #include <QTimer>
 #include <QVBoxLayout>
 
+#include <algorithm>
+
 // Normalize path to use `/`
 static inline QString normalizeFilePath(const QString &path) {
     return QDir::fromNativeSeparators(path);
@@ -36,85 +41,157 @@ static inline QString normalizeDirPath(const QString &path) {
     return p;
 }
 
-// Convert glob to regex list
-static QList<QRegularExpression> toRegexList(const QStringList &patterns) {
-    auto list = QList<QRegularExpression>();
-    for (auto &pat : patterns) {
-        auto rx = QString();
-        for (auto ch : pat.trimmed()) {
-            if (ch == '*') {
-                rx += ".*";
-            } else if (ch == '?') {
-                rx += '.';
-            } else if (QString("[](){}.+^$|\\").contains(ch)) {
-                rx += '\\';
-                rx += ch;
-            } else {
-                rx += ch;
-            }
-        }
-        if (!rx.isEmpty()) {
-            list << QRegularExpression("^" + rx + "$", QRegularExpression::CaseInsensitiveOption);
-        }
-    }
-    return list;
-}
-
 FileScannerWorker::FileScannerWorker(QObject *parent) : QObject(parent) {}
 
+FileScannerWorker::~FileScannerWorker() = default;
+
 void FileScannerWorker::setRootDir(const QString &dir) { rootDir = dir; }
 
 void FileScannerWorker::start() {
     QElapsedTimer timer;
     timer.start();
     shouldStop = false;
-    scanDir(rootDir);
+
+    cache = std::make_unique<FileListCache>(rootDir);
+    auto const cacheFile = FileListCache::cacheFileName(rootDir);
+    if (cache->load(cacheFile) && !sendFiles(cache->getFiles())) {
+        emit finished(timer.elapsed());
+        return;
+    }
+
+    // The walker never calls this concurrently, and blocking here pauses all of its threads
+    auto chunk = QStringList();
+    auto onFiles = [&](QStringList &&files) {
+        chunk.append(std::move(files));
+        if (chunk.size() >= ChunkSize && sendFiles(chunk)) {
+            chunk.clear();
+        }
+    };
+    auto added = QStringList();
+    auto removed = QStringList();
+    if (!cache->refresh(added, removed, shouldStop, onFiles)) {
+        qDebug() << "Requested to abort" << rootDir;
+        emit finished(timer.elapsed());
+        return;
+    }
+    if (!sendFiles(chunk)) {
+        emit finished(timer.elapsed());
+        return;
+    }
+    if (!added.isEmpty() || !removed.isEmpty()) {
+        emit filesChanged(added, removed);
+    }
+    cache->save(cacheFile);
     emit finished(timer.elapsed());
+    watchTree();
 }
 
-void FileScannerWorker::scanDir(const QString &rootPath) {
-    auto chunk = QStringList();
-    auto const chunkSize = 1000;
-    auto queue = QQueue<QString>();
-    queue.enqueue(rootPath);
+// Runs in the worker's thread, whose event loop delivers the watcher's events
+void FileScannerWorker::watchTree() {
+    watcher = new DirectoryWatcher(rootDir, this);
+    connect(watcher, &DirectoryWatcher::directoriesChanged, this,
+            &FileScannerWorker::updateDirectories);
+    connect(watcher, &DirectoryWatcher::overflowed, this, [this]() {
+        refreshTree();
+        if (!watcher->watch(cache->getDirectories())) {
+            startPolling();
+        }
+    });
 
-    while (!queue.isEmpty()) {
-        auto dirPath = queue.dequeue();
-        auto dir = QDir(dirPath);
-        auto entries = dir.entryInfoList(QDir::Files | QDir::Dirs | QDir::NoDotAndDotDot);
+    pollTimer = new QTimer(this);
+    pollTimer->setInterval(PollInterval);
+    connect(pollTimer, &QTimer::timeout, this, &FileScannerWorker::refreshTree);
+    if (!watcher->watch(cache->getDirectories())) {
+        startPolling();
+    }
+}
 
-        for (auto const &fi : std::as_const(entries)) {
+void FileScannerWorker::startPolling() {
+    qDebug() << "FileScannerWorker: polling for changes in" << rootDir;
+    // May be called from the watcher's own signals
+    watcher->deleteLater();
+    watcher = nullptr;
+    pollTimer->start();
+}
+
+void FileScannerWorker::updateDirectories(const QStringList &dirs) {
+    if (shouldStop || !watcher) {
+        return;
+    }
+    auto added = QStringList();
+    auto removed = QStringList();
+    auto newDirectories = QStringList();
+    cache->update(dirs, added, removed, newDirectories);
+    if (!newDirectories.isEmpty()) {
+        // Entries created before the watch was added were not reported, look again
+        if (!watcher->watch(newDirectories)) {
+            startPolling();
+        } else {
+            watcher->markChanged(newDirectories);
+        }
+    }
+    if (!added.isEmpty() || !removed.isEmpty()) {
+        emit filesChanged(added, removed);
+    }
+}
+
+void FileScannerWorker::refreshTree() {
+    auto added = QStringList();
+    auto removed = QStringList();
+    if (!cache->refresh(added, removed, shouldStop)) {
+        return;
+    }
+    if (!added.isEmpty() || !removed.isEmpty()) {
+        emit filesChanged(added, removed);
+    }
+}
+
+void FileScannerWorker::requestStop() {
+    {
+        auto lock = std::unique_lock(chunksMutex);
+        shouldStop = true;
+    }
+    chunksCondition.notify_all();
+}
+
+void FileScannerWorker::chunkConsumed() {
+    {
+        auto lock = std::unique_lock(chunksMutex);
+        pendingChunks--;
+    }
+    chunksCondition.notify_all();
+}
+
+// Sends the files in chunks, waiting while too many are pending. Returns false if the scan
+// was stopped meanwhile.
+bool FileScannerWorker::sendFiles(const QStringList &files) {
+    for (auto start = qsizetype(0); start < files.size(); start += ChunkSize) {
+        {
+            auto lock = std::unique_lock(chunksMutex);
+            chunksCondition.wait(
+                lock, [this]() { return shouldStop || pendingChunks < MaxPendingChunks; });
             if (shouldStop) {
-                qDebug() << "Requested to abort" << rootPath;
-                return;
-            }
-            if (fi.isDir()) {
-                queue.enqueue(normalizeFilePath(fi.absoluteFilePath()));
-            } else {
-                auto rel = QDir(rootDir).relativeFilePath(fi.absoluteFilePath());
-                chunk << normalizeFilePath(rel);
-                if (chunk.size() >= chunkSize) {
-                    emit filesChunkFound(chunk);
-                    chunk.clear();
-                    QThread::msleep(20);
-                }
+                return false;
             }
+            pendingChunks++;
         }
+        emit filesChunkFound(files.mid(start, ChunkSize));
     }
-    if (!chunk.isEmpty()) {
-        emit filesChunkFound(chunk);
-    }
+    return !shouldStop;
 }
 
+FilesList::~FilesList() { clear(); }
+
 FilesList::FilesList(QWidget *parent) : QWidget(parent) {
     auto layout = new QVBoxLayout(this);
     layout->setContentsMargins(0, 0, 0, 0);
     excludeEdit = new QLineEdit(this);
     showEdit = new QLineEdit(this);
     loadingWidget = new LoadingWidget(this);
-    filesModel = new FilesListModel();
+    filesModel = new FilesListModel(this);
     displayList = new QListView(this);
     displayList->setAlternatingRowColors(true);
+    displayList->setUniformItemSizes(true);
     displayList->setModel(filesModel);
 
     showEdit->setClearButtonEnabled(true);
@@ -143,8 +220,8 @@ FilesList::FilesList(QWidget *parent) : QWidget(parent) {
     updateTimer = new QTimer(this);
     updateTimer->setSingleShot(true);
     updateTimer->setInterval(300);
-    connect(updateTimer, &QTimer::timeout, this, [this]() { updateList(allFilesList, true); });
-    updateList(allFilesList, true);
+    connect(updateTimer, &QTimer::timeout, this, [this]() { updateList(allFiles, true); });
+    resetPaths();
 }
 
 void FilesList::setExcludeListEnabled(bool state) { this->excludeEdit->setEnabled(state); }
@@ -184,21 +261,38 @@ void FilesList::setDir(const QString &dir) {
                 if (currentGen != scanGeneration || w != this->worker) {
                     return;
                 }
-                allFilesList.append(chunk);
-                updateList(chunk, false);
+                auto ids = paths->add(chunk);
+                allFiles.append(ids);
+                updateList(ids, false);
+                w->chunkConsumed();
             });
+    connect(w, &FileScannerWorker::filesChanged, this,
+            [this, w, currentGen](const QStringList &added, const QStringList &files) {
+                if (currentGen != scanGeneration || w != this->worker) {
+                    return;
+                }
+                if (!files.isEmpty()) {
+                    auto removedIds = paths->remove(QSet<QString>(files.cbegin(), files.cend()));
+                    auto removed = QSet<PathStore::FileId>(removedIds.cbegin(), removedIds.cend());
+                    allFiles.removeIf([&removed](auto id) { return removed.contains(id); });
+                    filesModel->removeFiles(removed);
+                }
+                if (!added.isEmpty()) {
+                    auto ids = paths->add(added);
+                    allFiles.append(ids);
+                    updateList(ids, false);
+                }
+            });
+    // The worker keeps watching the tree, it is deleted when its thread quits (see clear())
     connect(w, &FileScannerWorker::finished, this, [this, w](qint64 ms) {
         auto msg = w->requestedStop() ? "Scan aborted after" : "Scan finished in";
         qDebug() << "FilesList::setDir" << msg << ms << "ms, " << w->getRootDir();
         if (w == this->worker) {
-            this->worker = nullptr;
-            this->scanThread->quit();
-            this->scanThread = nullptr;
             this->loadingWidget->stop();
         }
-        w->deleteLater();
     });
     connect(scanThread, &QThread::started, worker, &FileScannerWorker::start);
+    connect(scanThread, &QThread::finished, worker, &QObject::deleteLater);
     connect(scanThread, &QThread::finished, scanThread, &QObject::deleteLater);
     scanThread->start();
     loadingWidget->start();
@@ -206,10 +300,24 @@ void FilesList::setDir(const QString &dir) {
 }
 
 void FilesList::setFiles(const QStringList &files) {
-    allFilesList = files;
+    resetPaths();
+    auto normalized = QStringList();
+    normalized.reserve(files.size());
+    for (auto const &file : files) {
+        normalized.append(normalizeFilePath(file));
+    }
+    allFiles = paths->add(normalized);
     scheduleUpdateList();
 }
 
+// Ids are never reused: a new list of files starts a new store. Views and pending filter
+// tasks may still hold the previous one.
+void FilesList::resetPaths() {
+    paths = std::make_shared<PathStore>();
+    allFiles.clear();
+    filesModel->setPaths(paths);
+}
+
 void FilesList::clear() {
     scanGeneration++;
 
@@ -226,14 +334,11 @@ void FilesList::clear() {
         scanThread = nullptr;
     }
 
-    allFilesList.clear();
-    filesModel->clear();
+    resetPaths();
     loadingWidget->stop();
     directory.clear();
 }
 
-const QStringList &FilesList::currentFilteredFiles() const { return filesModel->getFiles(); }
-
 void FilesList::scheduleUpdateList() {
     if (updateTimer->isActive()) {
         updateTimer->stop();
@@ -241,85 +346,154 @@ void FilesList::scheduleUpdateList() {
     updateTimer->start();
 }
 
-bool FilesList::matchesFilters(const QString &filename,
-                               const QList<QRegularExpression> &excludeRegexes,
-                               const QList<QRegularExpression> &showRegexes,
-                               const QStringList &showTokens) const {
-    auto normPath = normalizeFilePath(filename);
-    auto segments = normPath.split('/', Qt::SkipEmptyParts);
-
-    for (auto const &rx : excludeRegexes) {
-        for (auto const &segment : segments) {
-            if (rx.match(segment).hasMatch()) {
-                return false;
+FileFilters::FileFilters(const QString &excludesText, const QString &showsText)
+    : excludesText(excludesText), showsText(showsText),
+      excludes(GlobSet::splitList(excludesText), GlobSet::MatchType::Whole, Qt::CaseInsensitive),
+      shows(GlobSet::splitList(showsText), GlobSet::MatchType::Whole, Qt::CaseInsensitive),
+      showTokens(GlobSet::splitList(showsText)) {}
+
+// Which of the filters match any '/' separated segment of the path
+struct SegmentMatch {
+    bool excluded = false;
+    bool shown = false;
+};
+
+static SegmentMatch matchSegments(QStringView path, const FileFilters &filters) {
+    auto forEachSegment = [path](auto &&predicate) {
+        for (auto start = qsizetype(0); start < path.size();) {
+            auto end = path.indexOf('/', start);
+            if (end < 0) {
+                end = path.size();
+            }
+            if (end > start && predicate(path.sliced(start, end - start))) {
+                return true;
             }
+            start = end + 1;
         }
+        return false;
+    };
+
+    auto match = SegmentMatch();
+    match.excluded =
+        !filters.excludes.isEmpty() &&
+        forEachSegment([&](QStringView segment) { return filters.excludes.matches(segment); });
+    match.shown = filters.shows.isEmpty() || forEachSegment([&](QStringView segment) {
+                      if (filters.shows.matches(segment)) {
+                          return true;
+                      }
+                      for (auto const &token : filters.showTokens) {
+                          if (segment.contains(token, Qt::CaseInsensitive)) {
+                              return true;
+                          }
+                      }
+                      return false;
+                  });
+    return match;
+}
+
+// Compiling the filters is cheap, but chunks arrive often while scanning
+std::shared_ptr<const FileFilters> FilesList::currentFilters() {
+    const auto excludesText = excludeEdit->text();
+    const auto showsText = showEdit->text();
+    if (!filters || filters->excludesText != excludesText || filters->showsText != showsText) {
+        filters = std::make_shared<const FileFilters>(excludesText, showsText);
     }
+    return filters;
+}
 
-    if (!showRegexes.isEmpty() || !showTokens.isEmpty()) {
-        auto matched = false;
-        for (auto const &rx : showRegexes) {
-            for (auto const &segment : segments) {
-                if (rx.match(segment).hasMatch()) {
-                    matched = true;
-                    break;
+void FilesList::updateList(const QList<PathStore::FileId> &chunk, bool clearList) {
+    auto task = [this, chunk, clearList, paths = std::shared_ptr<const PathStore>(paths),
+                 filters = currentFilters()]() {
+        // Only the names are copied while the store is locked, so the UI thread can keep
+        // adding files while they are filtered and sorted
+        struct File {
+            PathStore::FileId id;
+            uint32_t directory;
+            QStringView directoryPath;
+            qsizetype nameOffset;
+            qsizetype nameLength;
+        };
+        auto files = std::vector<File>();
+        auto names = QString();
+        auto directories = QHash<uint32_t, QString>();
+        {
+            auto lock = paths->lockForReading();
+            files.reserve(chunk.size());
+            for (auto id : chunk) {
+                if (paths->isRemoved(id)) {
+                    continue;
                 }
-            }
-            if (matched) {
-                break;
-            }
-        }
-        if (!matched && !showTokens.isEmpty()) {
-            for (auto const &segment : segments) {
-                const auto lowerSegment = segment.toLower();
-                for (auto const &token : showTokens) {
-                    if (lowerSegment.contains(token)) {
-                        matched = true;
-                        break;
-                    }
-                }
-                if (matched) {
-                    break;
+                auto directory = paths->directoryId(id);
+                auto directoryPath = directories.constFind(directory);
+                if (directoryPath == directories.cend()) {
+                    directoryPath = directories.insert(
+                        directory, paths->directoryPath(directory).toString());
                 }
+                auto name = paths->fileName(id);
+                files.push_back({id, directory, *directoryPath, names.size(), name.size()});
+                names.append(name);
             }
         }
-        if (!matched) {
-            return false;
+        auto nameOf = [&names](const File &file) {
+            return QStringView(names).sliced(file.nameOffset, file.nameLength);
+        };
+
+        // Directories are shared by many files, their segments are matched once
+        auto directoryMatches = QHash<uint32_t, SegmentMatch>();
+        auto filteredFiles = std::vector<File>();
+        for (auto const &file : files) {
+            auto dirMatch = directoryMatches.constFind(file.directory);
+            if (dirMatch == directoryMatches.cend()) {
+                dirMatch = directoryMatches.insert(file.directory,
+                                                   matchSegments(file.directoryPath, *filters));
+            }
+            if (dirMatch->excluded) {
+                continue;
+            }
+            auto nameMatch = matchSegments(nameOf(file), *filters);
+            if (!nameMatch.excluded && (dirMatch->shown || nameMatch.shown)) {
+                filteredFiles.push_back(file);
+            }
         }
-    }
-    return true;
-}
-
-void FilesList::updateList(const QStringList &chunk, bool clearList) {
-    const auto excludesText = excludeEdit->text();
-    const auto showsText = showEdit->text();
-    QThreadPool::globalInstance()->start([this, chunk, clearList, excludesText, showsText]() {
-        auto excludes = toRegexList(excludesText.split(';', Qt::SkipEmptyParts));
-        auto shows = toRegexList(showsText.split(';', Qt::SkipEmptyParts));
-        auto showTokens = showsText.toLower().split(';', Qt::SkipEmptyParts);
-        auto filtered = QStringList();
-
-        for (auto const &rel : chunk) {
-            if (matchesFilters(rel, excludes, shows, showTokens)) {
-                filtered << rel;
+        std::sort(filteredFiles.begin(), filteredFiles.end(), [&](const File &a, const File &b) {
+            if (a.directory == b.directory) {
+                return nameOf(a).compare(nameOf(b), Qt::CaseInsensitive) < 0;
             }
+            return PathStore::lessThan(a.directoryPath, nameOf(a), b.directoryPath, nameOf(b));
+        });
+        auto filtered = QList<PathStore::FileId>();
+        filtered.reserve(qsizetype(filteredFiles.size()));
+        for (auto const &file : filteredFiles) {
+            filtered << file.id;
         }
 
-        QElapsedTimer t1;
-        t1.start();
-        filtered.sort(Qt::CaseInsensitive);
-        QTimer::singleShot(0, this, [this, clearList, filtered]() {
-            QElapsedTimer t1;
-            t1.start();
+        QTimer::singleShot(0, this, [this, clearList, filtered, paths]() mutable {
+            if (paths != this->paths) {
+                // A new directory was set meanwhile
+                return;
+            }
+            filtered.removeIf([&paths](auto id) { return paths->isRemoved(id); });
             if (clearList) {
                 this->filesModel->clear();
             }
 
+            // Rows inserted above the view would push what the user is looking at down
+            auto scrollBar = displayList->verticalScrollBar();
+            auto top = QPersistentModelIndex();
+            if (scrollBar->value() != scrollBar->minimum()) {
+                top = displayList->indexAt({0, 0});
+            }
             filesModel->addFiles(filtered);
+            if (top.isValid()) {
+                displayList->scrollTo(top, QAbstractItemView::PositionAtTop);
+            }
         });
-    });
+    };
+    QThreadPool::globalInstance()->start(task);
 }
 
+FilesListModel::FilesListModel(QObject *parent) : QAbstractListModel(parent) {}
+
 void FilesListModel::clear() {
     beginResetModel();
     displayFiles.clear();
@@ -328,21 +502,104 @@ void FilesListModel::clear() {
 
 void FilesListModel::setBaseDir(const QString &newBaseDir) { baseDir = newBaseDir; }
 
-void FilesListModel::addFiles(const QStringList &l) {
+void FilesListModel::setPaths(std::shared_ptr<const PathStore> newPaths) {
     beginResetModel();
-    displayFiles.append(l);
+    paths = std::move(newPaths);
+    displayFiles.clear();
     endResetModel();
 }
 
+void FilesListModel::addFiles(const QList<PathStore::FileId> &l) {
+    if (l.isEmpty()) {
+        return;
+    }
+    auto lessThan = [this](auto a, auto b) { return paths->lessThan(a, b); };
+
+    // Where each new file goes, as runs of new files sharing an insertion point
+    struct Run {
+        qsizetype row;
+        qsizetype first;
+        qsizetype count;
+    };
+    auto runs = QList<Run>();
+    auto const oldSize = displayFiles.size();
+    for (auto i = qsizetype(0); i < l.size(); i++) {
+        auto row = std::upper_bound(displayFiles.cbegin(), displayFiles.cend(), l[i], lessThan) -
+                   displayFiles.cbegin();
+        if (!runs.isEmpty() && runs.last().row == row) {
+            runs.last().count++;
+        } else {
+            runs.append({row, i, 1});
+        }
+    }
+
+    if (runs.size() <= MaxInsertRuns) {
+        // From the end, so the rows of the runs before stay valid
+        for (auto run = runs.crbegin(); run != runs.crend(); ++run) {
+            beginInsertRows({}, run->row, run->row + run->count - 1);
+            displayFiles.insert(run->row, run->count, 0);
+            std::copy_n(l.cbegin() + run->first, run->count, displayFiles.begin() + run->row);
+            endInsertRows();
+        }
+        return;
+    }
+
+    // Many scattered rows: append them, then merge in one pass as a layout change, moving
+    // the persistent indexes (selection, current item) along
+    beginInsertRows({}, oldSize, oldSize + l.size() - 1);
+    displayFiles.append(l);
+    endInsertRows();
+
+    emit layoutAboutToBeChanged({}, QAbstractItemModel::VerticalSortHint);
+    auto const oldBegin = displayFiles.cbegin();
+    auto const oldEnd = displayFiles.cbegin() + oldSize;
+    auto from = persistentIndexList();
+    auto to = QModelIndexList();
+    to.reserve(from.size());
+    for (auto const &index : std::as_const(from)) {
+        auto row = qsizetype(index.row());
+        if (row < oldSize) {
+            // Old rows move down by the new files before them
+            row += std::lower_bound(l.cbegin(), l.cend(), displayFiles[row], lessThan) -
+                   l.cbegin();
+        } else {
+            auto file = displayFiles[row];
+            row = (row - oldSize) + (std::upper_bound(oldBegin, oldEnd, file, lessThan) - oldBegin);
+        }
+        to.append(createIndex(row, index.column()));
+    }
+    std::inplace_merge(displayFiles.begin(), displayFiles.begin() + oldSize, displayFiles.end(),
+                       lessThan);
+    changePersistentIndexList(from, to);
+    emit layoutChanged({}, QAbstractItemModel::VerticalSortHint);
+}
+
+void FilesListModel::removeFiles(const QSet<PathStore::FileId> &files) {
+    // From the end, one contiguous run of rows at a time, so the rows before stay valid
+    for (auto last = displayFiles.size() - 1; last >= 0; last--) {
+        if (!files.contains(displayFiles[last])) {
+            continue;
+        }
+        auto first = last;
+        while (first > 0 && files.contains(displayFiles[first - 1])) {
+            first--;
+        }
+        beginRemoveRows({}, first, last);
+        displayFiles.remove(first, last - first + 1);
+        endRemoveRows();
+        last = first;
+    }
+}
+
 int FilesListModel::rowCount(const QModelIndex &) const { return displayFiles.size(); }
 
 QVariant FilesListModel::data(const QModelIndex &index, int role) const {
     switch (role) {
     case Qt::DisplayRole:
-        return displayFiles[index.row()];
+        return paths->path(displayFiles[index.row()]);
         break;
     case Qt::ToolTipRole:
-        return baseDir + displayFiles[index.row()];
+        return baseDir + paths->path(displayFiles[index.row()]);
         break;
     default:
         return {};
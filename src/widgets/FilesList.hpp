@@ -8,49 +8,114 @@
 
 #pragma once
 
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+
+#include <QSet>
 #include <QStringList>
 #include <QThread>
 #include <QTimer>
 #include <QWidget>
 #include <qabstractitemmodel.h>
 
+#include "GlobSet.hpp"
+#include "PathStore.hpp"
+
 class QLineEdit;
 class QListView;
+class DirectoryWatcher;
+class FileListCache;
 class FileScannerWorker;
 class FileFilterWorker;
 class LoadingWidget;
 
+// Lists the files of a directory tree on a pool of threads, and reports them in chunks.
+// At most a few chunks are in flight: the scan waits until the receiver calls
+// chunkConsumed(), instead of flooding its event queue.
+//
+// The list is kept in a FileListCache between runs. The cached files are reported first,
+// then only the directories which changed are read again, and the differences reported.
+//
+// After the scan the tree is watched (see DirectoryWatcher), and the changes are reported as
+// they happen, until the worker's thread quits. Where the tree cannot be watched, it is checked
+// again every PollInterval instead.
 class FileScannerWorker : public QObject {
     Q_OBJECT
   public:
+    static constexpr int ChunkSize = 1000;
+    static constexpr int MaxPendingChunks = 4;
+    static constexpr int PollInterval = 10000;
+
     explicit FileScannerWorker(QObject *parent = nullptr);
+    ~FileScannerWorker();
     void setRootDir(const QString &dir);
     const QString &getRootDir() const { return rootDir; }
+    // Thread safe
+    void chunkConsumed();
 
   public slots:
     void start();
-    void requestStop() { shouldStop = true; }
+    void requestStop();
     bool requestedStop() const { return shouldStop; }
 
   signals:
     void filesChunkFound(const QStringList &chunk);
+    void filesChanged(const QStringList &added, const QStringList &removed);
     void finished(qint64 elapsedMs);
 
   private:
-    void scanDir(const QString &rootPath);
+    bool sendFiles(const QStringList &files);
+    void watchTree();
+    void startPolling();
+    void updateDirectories(const QStringList &dirs);
+    void refreshTree();
+
     QString rootDir;
-    bool shouldStop = false;
+    std::atomic<bool> shouldStop = false;
+    std::unique_ptr<FileListCache> cache;
+    DirectoryWatcher *watcher = nullptr;
+    QTimer *pollTimer = nullptr;
+
+    std::mutex chunksMutex;
+    std::condition_variable chunksCondition;
+    int pendingChunks = 0;
 };
 
+// The exclude and show lists, compiled once per edit of the filter texts
+struct FileFilters {
+    FileFilters(const QString &excludesText, const QString &showsText);
+
+    QString excludesText;
+    QString showsText;
+    GlobSet excludes;
+    GlobSet shows;
+    QStringList showTokens;
+};
+
+// The files are kept sorted (case insensitive), as ids of a PathStore, and their paths are
+// built only when displayed. New files are merged in with row inserts, so views keep their
+// selection while a scan streams in.
 class FilesListModel : public QAbstractListModel {
     QString baseDir;
-    QStringList displayFiles;
+    std::shared_ptr<const PathStore> paths;
+    QList<PathStore::FileId> displayFiles;
 
   public:
+    // Above this many separate runs of new rows, a merge is applied as one layout change
+    static constexpr int MaxInsertRuns = 32;
+
+    explicit FilesListModel(QObject *parent = nullptr);
     void clear();
     void setBaseDir(const QString &newBaseDir);
-    void addFiles(const QStringList &l);
-    const QStringList &getFiles() const { return displayFiles; }
+    // Clears the list, the files added afterwards are from this store
+    void setPaths(std::shared_ptr<const PathStore> newPaths);
+    // The files must be sorted already (see PathStore::lessThan)
+    void addFiles(const QList<PathStore::FileId> &l);
+    // Removes the rows of the files, keeping the rest (and the selection) in place
+    void removeFiles(const QSet<PathStore::FileId> &files);
+    const QList<PathStore::FileId> &getFiles() const { return displayFiles; }
     virtual int rowCount(const QModelIndex &parent) const override;
     virtual QVariant data(const QModelIndex &index, int role) const override;
 };
@@ -59,6 +124,7 @@ class FilesList : public QWidget {
     Q_OBJECT
   public:
     explicit FilesList(QWidget *parent = nullptr);
+    ~FilesList();
 
     void setShowList(const QString &filter);
     void setShowListEnabled(bool state);
@@ -69,20 +135,21 @@ class FilesList : public QWidget {
     void setDir(const QString &dir);
     const QString &getDir() const { return directory; };
     void clear();
-    const QStringList &currentFilteredFiles() const;
-    const QStringList &getAllFiles() const { return allFilesList; }
+    // The files shown, as ids of getPaths()
+    const QList<PathStore::FileId> &currentFilteredFiles() const { return filesModel->getFiles(); }
+    const QList<PathStore::FileId> &getAllFiles() const { return allFiles; }
+    std::shared_ptr<const PathStore> getPaths() const { return paths; }
 
   signals:
     void fileSelected(const QString &filename);
 
   private slots:
     void scheduleUpdateList();
-    void updateList(const QStringList &chunk, bool clearList);
+    void updateList(const QList<PathStore::FileId> &chunk, bool clearList);
 
   private:
-    bool matchesFilters(const QString &filename, const QList<QRegularExpression> &excludeRegexes,
-                        const QList<QRegularExpression> &showRegexes,
-                        const QStringList &showTokens) const;
+    std::shared_ptr<const FileFilters> currentFilters();
+    void resetPaths();
 
     LoadingWidget *loadingWidget = nullptr;
     FilesListModel *filesModel = nullptr;
@@ -92,10 +159,12 @@ class FilesList : public QWidget {
     quint64 scanGeneration = 0;
 
     QString directory;
-    QStringList allFilesList;
+    std::shared_ptr<PathStore> paths;
+    QList<PathStore::FileId> allFiles;
 
     FileScannerWorker *worker = nullptr;
     QThread *scanThread = nullptr;
     FileFilterWorker *filterWorker = nullptr;
     QTimer *updateTimer = nullptr;
+    std::shared_ptr<const FileFilters> filters;
 };
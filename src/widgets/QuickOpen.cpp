@@ -0,0 +1,172 @@
+/**
+ * \file QuickOpen.cpp
+ * \brief Implementation of a popup for opening project files by a fuzzy name
+ * \author Diego Iastrubni diegoiast@gmail.com
+ */
+
+// SPDX-License-Identifier: MIT
+
+#include "QuickOpen.hpp"
+
+#include <QApplication>
+#include <QKeyEvent>
+#include <QLineEdit>
+#include <QListView>
+#include <QVBoxLayout>
+#include <QtConcurrent/QtConcurrentRun>
+
+#include <algorithm>
+#include <cmath>
+
+// A file used a few times today is worth about two well placed characters
+static constexpr auto BoostScale = 24.0;
+
+QuickOpenModel::QuickOpenModel(QObject *parent) : QAbstractListModel(parent) {}
+
+void QuickOpenModel::setResults(std::shared_ptr<const PathStore> newPaths,
+                                const QList<PathStore::FileId> &newResults) {
+    beginResetModel();
+    paths = std::move(newPaths);
+    results = newResults;
+    endResetModel();
+}
+
+int QuickOpenModel::rowCount(const QModelIndex &) const { return results.size(); }
+
+QVariant QuickOpenModel::data(const QModelIndex &index, int role) const {
+    switch (role) {
+    case Qt::DisplayRole:
+    case Qt::ToolTipRole:
+        return paths->path(results[index.row()]);
+    default:
+        return {};
+    }
+}
+
+QuickOpen::QuickOpen(QWidget *parent) : QFrame(parent, Qt::Popup) {
+    setFrameShape(QFrame::StyledPanel);
+    auto layout = new QVBoxLayout(this);
+    layout->setContentsMargins(4, 4, 4, 4);
+    queryEdit = new QLineEdit(this);
+    queryEdit->setPlaceholderText(tr("File name"));
+    queryEdit->installEventFilter(this);
+    model = new QuickOpenModel(this);
+    resultsView = new QListView(this);
+    resultsView->setUniformItemSizes(true);
+    resultsView->setFocusPolicy(Qt::NoFocus);
+    resultsView->setModel(model);
+    layout->addWidget(queryEdit);
+    layout->addWidget(resultsView);
+
+    matchWatcher = new QFutureWatcher<QList<PathStore::FileId>>(this);
+    connect(matchWatcher, &QFutureWatcherBase::finished, this, &QuickOpen::matchDone);
+    connect(queryEdit, &QLineEdit::textChanged, this, &QuickOpen::updateResults);
+    connect(resultsView, &QListView::clicked, this, &QuickOpen::chooseFile);
+}
+
+QuickOpen::~QuickOpen() { matchWatcher->waitForFinished(); }
+
+void QuickOpen::setFiles(std::shared_ptr<const PathStore> paths,
+                         const QList<PathStore::FileId> &files,
+                         const QHash<QString, double> &frecencies) {
+    auto boosts = QHash<QString, int>();
+    for (auto it = frecencies.cbegin(); it != frecencies.cend(); ++it) {
+        auto boost = int(BoostScale * std::log2(1 + it.value()));
+        if (boost > 0) {
+            boosts.insert(it.key(), std::min(boost, int(MaxBoost)));
+        }
+    }
+    // The matcher cannot change under a running match
+    matchWatcher->waitForFinished();
+    generation++;
+    matcher.setCandidates(std::move(paths), files, boosts);
+}
+
+void QuickOpen::popup() {
+    auto window = parentWidget() ? parentWidget()->window() : nullptr;
+    if (window) {
+        auto width = window->width() * 6 / 10;
+        auto height = window->height() / 2;
+        resize(width, height);
+        move(window->mapToGlobal(QPoint((window->width() - width) / 2, window->height() / 10)));
+    }
+    queryEdit->clear();
+    updateResults();
+    show();
+    queryEdit->setFocus();
+}
+
+bool QuickOpen::eventFilter(QObject *watched, QEvent *event) {
+    if (watched != queryEdit || event->type() != QEvent::KeyPress) {
+        return QFrame::eventFilter(watched, event);
+    }
+    auto keyEvent = static_cast<QKeyEvent *>(event);
+    switch (keyEvent->key()) {
+    case Qt::Key_Up:
+    case Qt::Key_Down:
+    case Qt::Key_PageUp:
+    case Qt::Key_PageDown:
+        QApplication::sendEvent(resultsView, event);
+        return true;
+    case Qt::Key_Return:
+    case Qt::Key_Enter:
+        // The shown results may be the boosted ones only
+        if (matchWatcher->isRunning() || matchGeneration != generation) {
+            matchWatcher->waitForFinished();
+            showResults(matcher.match(queryEdit->text(), MaxResults));
+            generation++;
+        }
+        chooseFile(resultsView->currentIndex());
+        return true;
+    case Qt::Key_Escape:
+        hide();
+        return true;
+    default:
+        return QFrame::eventFilter(watched, event);
+    }
+}
+
+void QuickOpen::updateResults() {
+    generation++;
+    // Does not touch the state a running match() uses
+    auto results = matcher.matchBoosted(queryEdit->text(), MaxResults);
+    if (!results.isEmpty()) {
+        showResults(results);
+    }
+    matchAll();
+}
+
+// A query typed while a match runs is matched when that one is done
+void QuickOpen::matchAll() {
+    if (matchWatcher->isRunning()) {
+        return;
+    }
+    auto const query = queryEdit->text();
+    matchGeneration = generation;
+    matchWatcher->setFuture(
+        QtConcurrent::run([this, query]() { return matcher.match(query, MaxResults); }));
+}
+
+void QuickOpen::matchDone() {
+    if (matchGeneration == generation) {
+        showResults(matchWatcher->result());
+    } else if (isVisible()) {
+        matchAll();
+    }
+}
+
+void QuickOpen::showResults(const QList<PathStore::FileId> &results) {
+    model->setResults(matcher.getPaths(), results);
+    if (!results.isEmpty()) {
+        resultsView->setCurrentIndex(model->index(0));
+    }
+}
+
+void QuickOpen::chooseFile(const QModelIndex &index) {
+    if (!index.isValid()) {
+        return;
+    }
+    auto fileName = index.data(Qt::DisplayRole).toString();
+    hide();
+    emit fileChosen(fileName);
+}
@@ -0,0 +1,78 @@
+/**
+ * \file QuickOpen.hpp
+ * \brief Definition of a popup for opening project files by a fuzzy name
+ * \author Diego Iastrubni diegoiast@gmail.com
+ */
+
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+#include <memory>
+
+#include <QAbstractListModel>
+#include <QFrame>
+#include <QFutureWatcher>
+
+#include "FuzzyMatcher.hpp"
+#include "PathStore.hpp"
+
+class QLineEdit;
+class QListView;
+
+// The best matches of the current query
+class QuickOpenModel : public QAbstractListModel {
+    std::shared_ptr<const PathStore> paths;
+    QList<PathStore::FileId> results;
+
+  public:
+    explicit QuickOpenModel(QObject *parent = nullptr);
+    void setResults(std::shared_ptr<const PathStore> newPaths,
+                    const QList<PathStore::FileId> &newResults);
+    virtual int rowCount(const QModelIndex &parent) const override;
+    virtual QVariant data(const QModelIndex &index, int role) const override;
+};
+
+// Matches the query against all the files as it is typed (see FuzzyMatcher), and shows the
+// best ones. The popup and its model are kept between invocations, only the files change.
+//
+// Recently used files are boosted by their frecency (see FrecencyStore). They are matched
+// first, and shown at once, while the full match runs in the background. One full match runs
+// at a time, and its results are shown only if the query did not change meanwhile.
+class QuickOpen : public QFrame {
+    Q_OBJECT
+  public:
+    static constexpr int MaxResults = 100;
+    static constexpr int MaxBoost = 96;
+
+    explicit QuickOpen(QWidget *parent);
+    ~QuickOpen();
+
+    // Relative paths, from the store. Frecencies are by relative path.
+    void setFiles(std::shared_ptr<const PathStore> paths, const QList<PathStore::FileId> &files,
+                  const QHash<QString, double> &frecencies = {});
+    // Shows the popup on top of the parent's window, with an empty query
+    void popup();
+
+  signals:
+    void fileChosen(const QString &relativePath);
+
+  protected:
+    bool eventFilter(QObject *watched, QEvent *event) override;
+
+  private:
+    void updateResults();
+    void matchAll();
+    void matchDone();
+    void showResults(const QList<PathStore::FileId> &results);
+    void chooseFile(const QModelIndex &index);
+
+    QLineEdit *queryEdit = nullptr;
+    QListView *resultsView = nullptr;
+    QuickOpenModel *model = nullptr;
+    QFutureWatcher<QList<PathStore::FileId>> *matchWatcher = nullptr;
+    FuzzyMatcher matcher;
+    // Bumped when the query or the files change, and noted when a full match starts
+    quint64 generation = 0;
+    quint64 matchGeneration = 0;
+};
@@ -564,6 +564,23 @@ void qmdiEditor::setState(const qmdiClientState &state) {
     }
 }
 
+void qmdiEditor::on_client_merged(qmdiHost *host) {
+    qmdiClient::on_client_merged(host);
+
+    // A document which is not loaded yet reports LoadedFile once it is, so the open is not
+    // counted twice
+    auto pluginManager = dynamic_cast<PluginManager *>(host);
+    if (!pluginManager || mdiClientFileName().isEmpty() || !documentHasBeenLoaded) {
+        return;
+    }
+    // clang-format off
+    pluginManager->handleCommand(GlobalCommands::ActivatedFile, {
+        {GlobalArguments::FileName, mdiClientFileName()},
+        {GlobalArguments::Client, QVariant::fromValue(static_cast<qmdiClient*>(this))},
+    });
+    // clang-format
+}
+
 void qmdiEditor::on_client_unmerged(qmdiHost *host) {
     qmdiClient::on_client_unmerged(host);
 
@@ -1221,6 +1238,36 @@ void qmdiEditor::setReadOnly(bool b) {
     }
 }
 
+std::optional<size_t>
+qmdiEditor::replaceInLines(const QMap<size_t, QString> &lines,
+                           const std::function<size_t(QString &line)> &replaceLine) {
+    auto document = textEditor->document();
+    for (auto it = lines.cbegin(); it != lines.cend(); ++it) {
+        auto block = document->findBlockByNumber(static_cast<int>(it.key()));
+        if (!block.isValid() || block.text() != it.value()) {
+            return {};
+        }
+    }
+
+    auto cursor = QTextCursor(document);
+    auto count = size_t(0);
+    cursor.beginEditBlock();
+    for (auto it = lines.cbegin(); it != lines.cend(); ++it) {
+        auto block = document->findBlockByNumber(static_cast<int>(it.key()));
+        auto text = block.text();
+        auto replaced = replaceLine(text);
+        if (replaced == 0) {
+            continue;
+        }
+        cursor.setPosition(block.position());
+        cursor.setPosition(block.position() + block.length() - 1, QTextCursor::KeepAnchor);
+        cursor.insertText(text);
+        count += replaced;
+    }
+    cursor.endEditBlock();
+    return count;
+}
+
 void qmdiEditor::transformBlockToUpper() {
     QTextCursor cursor = textEditor->textCursor();
     QString s_before = cursor.selectedText();
@@ -8,7 +8,11 @@
 
 #pragma once
 
+#include <functional>
+#include <optional>
+
 #include <QFuture>
+#include <QMap>
 #include <QStyledItemDelegate>
 #include <QToolButton>
 
@@ -63,6 +67,7 @@ class qmdiEditor : public QWidget, public qmdiClient {
     virtual std::optional<std::tuple<int, int, int>> get_coordinates() const override;
     virtual qmdiClientState getState() const override;
     virtual void setState(const qmdiClientState &state) override;
+    virtual void on_client_merged(qmdiHost *host) override;
     virtual void on_client_unmerged(qmdiHost *host) override;
 
     void setupActions();
@@ -99,6 +104,19 @@ class qmdiEditor : public QWidget, public qmdiClient {
 
     QString getSelectedText() const;
 
+    // False while the content of a restored tab has not been read from disk yet
+    inline bool isDocumentLoaded() const { return documentHasBeenLoaded; }
+    // True when the document has changes which were not saved
+    inline bool isModified() const { return textEditor->document()->isModified(); }
+    // A copy of the whole document, as currently edited
+    inline QString getDocumentText() const { return textEditor->toPlainText(); }
+    // Rewrites the given lines (by number, with the text they are expected to hold) through
+    // `replaceLine`, as a single undo step. Returns the number of replacements reported by
+    // `replaceLine`, or nothing if any of the lines was edited meanwhile, and then nothing
+    // is changed.
+    std::optional<size_t> replaceInLines(const QMap<size_t, QString> &lines,
+                                         const std::function<size_t(QString &line)> &replaceLine);
+
   public slots:
     void on_fileChanged(const QString &filename);
     void displayBannerMessage(QString message, int time);